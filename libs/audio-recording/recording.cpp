@@ -35,6 +35,319 @@ namespace record {
 static StreamRecording *recording = NULL;
 static SplitterChannel *splitterChannel = NULL;
 static MixerChannel *channel = NULL;
+
+// Most flash pages (4kB each on V2) holding flash recordings, from the end of the program, fewer
+// if the free flash ends before. This is the same free flash the flash log uses, so only one of
+// them gets it (claimFreeFlash).
+#ifndef AUDIO_RECORDING_FLASH_PAGES
+#define AUDIO_RECORDING_FLASH_PAGES 32
+#endif
+
+#define FLASH_RECORDING_CHUNK_WORDS 64
+#define FLASH_RECORDING_CHUNKS 4
+#define FLASH_RECORDING_PLAY_BYTES 128
+// "AREC", in the first word of the free flash
+#define FLASH_RECORDING_MARKER 0x43455241
+
+extern uint32_t __etext, __data_start__, __data_end__;
+
+// first page of the free flash, after the program and no lower than the flash log starts
+static uint32_t freeFlashStart() {
+    uint32_t pageSize = uBit.flash.getPageSize();
+    uint32_t programEnd =
+        (uint32_t)&__etext + ((uint32_t)&__data_end__ - (uint32_t)&__data_start__);
+    uint32_t start = (programEnd + pageSize - 1) & ~(pageSize - 1);
+    uint32_t logStart = uBit.flash.getFlashStart();
+    return start > logStart ? start : logStart;
+}
+
+// pages of the free flash the recordings may use, stopping where the flash log stops, before
+// the pages the bootloader and the settings keep
+static int freeFlashPages() {
+    uint32_t pageSize = uBit.flash.getPageSize();
+    uint32_t start = freeFlashStart();
+    uint32_t end = uBit.flash.getFlashEnd() & ~(pageSize - 1);
+    if (end <= start)
+        return 0;
+    return min((int)((end - start) / pageSize), AUDIO_RECORDING_FLASH_PAGES);
+}
+
+// The first page of the free flash only holds a marker, so that what another user left there,
+// such as the flash log of an earlier run, is never recorded over.
+static bool claimFlashRecording() {
+    // the marker and at least one page of audio
+    if (freeFlashPages() < 2)
+        return false;
+    uint32_t pageSize = uBit.flash.getPageSize();
+    // flash is memory mapped
+    const uint32_t *page = (const uint32_t *)freeFlashStart();
+    if (page[0] != FLASH_RECORDING_MARKER)
+        for (uint32_t i = 0; i < pageSize / 4; ++i)
+            if (page[i] != 0xffffffff)
+                return false;
+    if (!claimFreeFlash(FREE_FLASH_AUDIO))
+        return false;
+    if (page[0] != FLASH_RECORDING_MARKER) {
+        uint32_t marker = FLASH_RECORDING_MARKER;
+        uBit.flash.write((uint32_t)page, &marker, 1);
+    }
+    return true;
+}
+
+static const int16_t adpcmSteps[89] = {
+    7,     8,     9,     10,    11,    12,    13,    14,    16,    17,    19,    21,    23,
+    25,    28,    31,    34,    37,    41,    45,    50,    55,    60,    66,    73,    80,
+    88,    97,    107,   118,   130,   143,   157,   173,   190,   209,   230,   253,   279,
+    307,   337,   371,   408,   449,   494,   544,   598,   658,   724,   796,   876,   963,
+    1060,  1166,  1282,  1411,  1552,  1707,  1878,  2066,  2272,  2499,  2749,  3024,  3327,
+    3660,  4026,  4428,  4871,  5358,  5894,  6484,  7132,  7845,  8630,  9493,  10442, 11487,
+    12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767};
+
+static const int8_t adpcmIndexSteps[8] = {-1, -1, -1, -1, 2, 4, 6, 8};
+
+// IMA ADPCM, 4 bits per sample
+struct AdpcmState {
+    int predictor;
+    int index;
+
+    void reset() { predictor = index = 0; }
+
+    void advance(int code, int delta) {
+        predictor += (code & 8) ? -delta : delta;
+        predictor = predictor < -32768 ? -32768 : predictor > 32767 ? 32767 : predictor;
+        index += adpcmIndexSteps[code & 7];
+        index = index < 0 ? 0 : index > 88 ? 88 : index;
+    }
+
+    int encode(int sample) {
+        int step = adpcmSteps[index];
+        int diff = sample - predictor;
+        int code = 0;
+        if (diff < 0) {
+            code = 8;
+            diff = -diff;
+        }
+        int delta = step >> 3;
+        for (int bit = 4; bit; bit >>= 1, step >>= 1) {
+            if (diff >= step) {
+                code |= bit;
+                diff -= step;
+                delta += step;
+            }
+        }
+        advance(code, delta);
+        return code;
+    }
+
+    int decode(int code) {
+        int step = adpcmSteps[index];
+        int delta = step >> 3;
+        if (code & 4)
+            delta += step;
+        if (code & 2)
+            delta += step >> 1;
+        if (code & 1)
+            delta += step >> 2;
+        advance(code, delta);
+        return predictor;
+    }
+};
+
+/**
+ * Records from a splitter channel into flash as IMA ADPCM, and plays back into a mixer channel
+ * by decoding straight from flash, so the length of a clip does not cost any RAM.
+ * The audio interrupt encodes into a small ring of chunks; a fiber writes full chunks to flash,
+ * erasing each page as it reaches it. The ring covers longer than a page erase stalls the CPU.
+ * Clips start on the page after the marker of claimFlashRecording.
+ */
+class FlashRecording : public DataSink, public DataSource {
+  public:
+    DataSource &input;
+    DataSink *output;
+    uint32_t start;
+    uint32_t size;
+    uint32_t pageSize;
+    volatile uint32_t length;
+
+    uint32_t chunks[FLASH_RECORDING_CHUNKS][FLASH_RECORDING_CHUNK_WORDS];
+    int chunkWrite, chunkRead, chunkFill;
+    volatile int chunksPending;
+    uint32_t queued;
+    AdpcmState encoder;
+    int halfByte;
+    volatile bool recording;
+    volatile bool writing;
+
+    AdpcmState decoder;
+    uint32_t playPosition;
+    volatile bool playing;
+    float sampleRate;
+
+    FlashRecording(DataSource &input)
+        : input(input), output(NULL), length(0), chunkWrite(0), chunkRead(0), chunkFill(0),
+          chunksPending(0), queued(0), halfByte(-1), recording(false), writing(false),
+          playPosition(0), playing(false), sampleRate(11000) {
+        pageSize = uBit.flash.getPageSize();
+        start = freeFlashStart() + pageSize;
+        size = (freeFlashPages() - 1) * pageSize;
+        input.connect(*this);
+    }
+
+    uint8_t *chunkBytes(int i) { return (uint8_t *)chunks[i]; }
+
+    void push(int code) {
+        if (halfByte < 0) {
+            halfByte = code;
+            return;
+        }
+        chunkBytes(chunkWrite)[chunkFill++] = halfByte | (code << 4);
+        halfByte = -1;
+        queued++;
+        if (chunkFill == FLASH_RECORDING_CHUNK_WORDS * 4) {
+            chunkFill = 0;
+            chunkWrite = (chunkWrite + 1) % FLASH_RECORDING_CHUNKS;
+            chunksPending++;
+        }
+    }
+
+    virtual int pullRequest() override {
+        ManagedBuffer b = input.pull();
+        if (!recording)
+            return DEVICE_OK;
+        int format = input.getFormat();
+        int width = DATASTREAM_FORMAT_BYTES_PER_SAMPLE(format);
+        const uint8_t *p = b.getBytes();
+        for (int i = 0; i + width <= b.length() && recording; i += width) {
+            if (chunksPending == FLASH_RECORDING_CHUNKS || queued == size) {
+                // out of room: the clip ends here
+                recording = false;
+                break;
+            }
+            int v;
+            switch (format) {
+            case DATASTREAM_FORMAT_8BIT_UNSIGNED:
+                v = (p[i] - 128) << 8;
+                break;
+            case DATASTREAM_FORMAT_8BIT_SIGNED:
+                v = (int8_t)p[i] << 8;
+                break;
+            case DATASTREAM_FORMAT_16BIT_UNSIGNED:
+                v = (p[i] | (p[i + 1] << 8)) - 32768;
+                break;
+            default:
+                v = (int16_t)(p[i] | (p[i + 1] << 8));
+                break;
+            }
+            push(encoder.encode(v));
+        }
+        return DEVICE_OK;
+    }
+
+    void writeChunk(int i, int bytes) {
+        uint32_t address = start + length;
+        if (address % pageSize == 0)
+            uBit.flash.erase(address);
+        uBit.flash.write(address, chunks[i], (bytes + 3) >> 2);
+        length += bytes;
+    }
+
+    void writer() {
+        while (recording || chunksPending) {
+            if (!chunksPending) {
+                fiber_sleep(10);
+                continue;
+            }
+            writeChunk(chunkRead, FLASH_RECORDING_CHUNK_WORDS * 4);
+            chunkRead = (chunkRead + 1) % FLASH_RECORDING_CHUNKS;
+            __disable_irq();
+            chunksPending--;
+            __enable_irq();
+        }
+        // the ring is drained and the interrupt no longer writes, so the tail is ours
+        if (chunkFill)
+            writeChunk(chunkWrite, chunkFill);
+        writing = false;
+    }
+
+    void record() {
+        stop();
+        while (writing)
+            fiber_sleep(10);
+        length = 0;
+        queued = 0;
+        chunkWrite = chunkRead = chunkFill = chunksPending = 0;
+        halfByte = -1;
+        encoder.reset();
+        writing = true;
+        recording = true;
+        create_fiber(flashRecordingWriter, this);
+    }
+
+    static void flashRecordingWriter(void *self) { ((FlashRecording *)self)->writer(); }
+
+    void play() {
+        stop();
+        while (writing)
+            fiber_sleep(10);
+        if (!length || !output)
+            return;
+        playPosition = 0;
+        decoder.reset();
+        playing = true;
+        output->pullRequest();
+    }
+
+    void stop() {
+        recording = false;
+        playing = false;
+    }
+
+    void erase() {
+        stop();
+        while (writing)
+            fiber_sleep(10);
+        length = 0;
+    }
+
+    virtual ManagedBuffer pull() override {
+        if (!playing)
+            return ManagedBuffer();
+        int bytes = min((int)(length - playPosition), FLASH_RECORDING_PLAY_BYTES);
+        ManagedBuffer out(bytes * 4);
+        int16_t *samples = (int16_t *)out.getBytes();
+        // flash is memory mapped
+        const uint8_t *src = (const uint8_t *)(start + playPosition);
+        for (int i = 0; i < bytes; ++i) {
+            *samples++ = decoder.decode(src[i] & 0xf);
+            *samples++ = decoder.decode(src[i] >> 4);
+        }
+        playPosition += bytes;
+        if (playPosition >= length)
+            playing = false;
+        else
+            output->pullRequest();
+        return out;
+    }
+
+    virtual void connect(DataSink &sink) override { output = &sink; }
+    virtual bool isConnected() override { return output != NULL; }
+    virtual void disconnect() override { output = NULL; }
+    virtual int getFormat() override { return DATASTREAM_FORMAT_16BIT_SIGNED; }
+    virtual float getSampleRate() override { return sampleRate; }
+
+    int duration(int rate) { return rate > 0 ? (int)((uint64_t)length * 2 * 1000 / rate) : 0; }
+};
+
+static FlashRecording *flashRecording = NULL;
+static SplitterChannel *flashSplitterChannel = NULL;
+static MixerChannel *flashChannel = NULL;
+static bool useFlash = false;
+static int inputSampleRate = 11000;
+static int outputSampleRate = 11000;
+
+static bool flashMode() {
+    return useFlash && flashRecording;
+}
 #endif
 
 
@@ -65,7 +378,10 @@ void checkEnv(int sampleRate = -1) {
 void record() {
 #if MICROBIT_CODAL
     checkEnv();
-    recording->recordAsync();
+    if (flashMode())
+        flashRecording->record();
+    else
+        recording->recordAsync();
 #else
     target_panic(PANIC_VARIANT_NOT_SUPPORTED);
 #endif
@@ -78,7 +394,10 @@ void record() {
 void play() {
 #if MICROBIT_CODAL
     checkEnv();
-    recording->playAsync();
+    if (flashMode())
+        flashRecording->play();
+    else
+        recording->playAsync();
 #else
     target_panic(PANIC_VARIANT_NOT_SUPPORTED);
 #endif
@@ -91,7 +410,10 @@ void play() {
 void stop() {
 #if MICROBIT_CODAL
     checkEnv();
-    recording->stop();
+    if (flashMode())
+        flashRecording->stop();
+    else
+        recording->stop();
 #else
     target_panic(PANIC_VARIANT_NOT_SUPPORTED);
 #endif
@@ -104,7 +426,10 @@ void stop() {
 void erase() {
 #if MICROBIT_CODAL
     checkEnv();
-    recording->erase();
+    if (flashMode())
+        flashRecording->erase();
+    else
+        recording->erase();
 #endif
 }
 
@@ -124,6 +449,8 @@ void setMicrophoneGain(float gain) {
 //%
 int audioDuration(int sampleRate) {
 #if MICROBIT_CODAL
+    if (flashMode())
+        return flashRecording->duration(sampleRate);
     return recording->duration(sampleRate);
 #else
     target_panic(PANIC_VARIANT_NOT_SUPPORTED);
@@ -137,6 +464,8 @@ int audioDuration(int sampleRate) {
 //%
 bool audioIsPlaying() {
 #if MICROBIT_CODAL
+    if (flashMode())
+        return flashRecording->playing;
     return recording->isPlaying();
 #else
     return false;
@@ -149,6 +478,8 @@ bool audioIsPlaying() {
 //%
 bool audioIsRecording() {
 #if MICROBIT_CODAL
+    if (flashMode())
+        return flashRecording->recording;
     return recording->isRecording();
 #else
     return false;
@@ -161,6 +492,8 @@ bool audioIsRecording() {
 //%
 bool audioIsStopped() {
 #if MICROBIT_CODAL
+    if (flashMode())
+        return !flashRecording->recording && !flashRecording->playing;
     return recording->isStopped();
 #else
     return false;
@@ -175,6 +508,9 @@ void setInputSampleRate(int sampleRate) {
 #if MICROBIT_CODAL
     checkEnv();
     splitterChannel->requestSampleRate(sampleRate);
+    inputSampleRate = sampleRate;
+    if (flashSplitterChannel)
+        flashSplitterChannel->requestSampleRate(sampleRate);
 #else
     target_panic(PANIC_VARIANT_NOT_SUPPORTED);
 #endif
@@ -192,6 +528,11 @@ void setOutputSampleRate(int sampleRate) {
     } else {
         channel->setSampleRate(sampleRate);
     }
+    outputSampleRate = sampleRate;
+    if (flashChannel) {
+        flashChannel->setSampleRate(sampleRate);
+        flashRecording->sampleRate = sampleRate;
+    }
 #else
     target_panic(PANIC_VARIANT_NOT_SUPPORTED);
 #endif
@@ -204,7 +545,38 @@ void setOutputSampleRate(int sampleRate) {
 void setBothSamples(int sampleRate) {
 #if MICROBIT_CODAL
     setOutputSampleRate(sampleRate);
-    splitterChannel->requestSampleRate(sampleRate);
+    setInputSampleRate(sampleRate);
+#else
+    target_panic(PANIC_VARIANT_NOT_SUPPORTED);
+#endif
+}
+
+/**
+ * Choose whether clips are recorded compressed to flash, rather than to RAM. Clips stay in RAM
+ * if the flash log has the flash, if it holds data that is not an audio clip, or if the program
+ * leaves less than two pages of it.
+ */
+//%
+void setFlashStorage(bool flash) {
+#if MICROBIT_CODAL
+    checkEnv();
+    if (flash == useFlash)
+        return;
+    if (flash && !flashRecording) {
+        if (!claimFlashRecording())
+            return;
+        flashSplitterChannel = uBit.audio.splitter->createChannel();
+        flashSplitterChannel->requestSampleRate(inputSampleRate);
+        flashRecording = new FlashRecording(*flashSplitterChannel);
+        flashRecording->sampleRate = outputSampleRate;
+        flashChannel = uBit.audio.mixer.addChannel(*flashRecording, outputSampleRate);
+        flashChannel->setVolume(75.0);
+    }
+    if (useFlash)
+        flashRecording->stop();
+    else
+        recording->stop();
+    useFlash = flash;
 #else
     target_panic(PANIC_VARIANT_NOT_SUPPORTED);
 #endif
@@ -76,6 +76,13 @@ namespace record {
         BufferEmpty,
     }
 
+    export enum AudioRecordingStorage {
+        //% block="memory"
+        Memory,
+        //% block="flash"
+        Flash
+    }
+
     export enum BlockingState {
         //% block="until done"
         Blocking,
@@ -206,4 +213,18 @@ namespace record {
                 break;
         }
     }
+
+    /**
+     * Choose where audio clips are recorded. Clips in flash are compressed and can be
+     * much longer than in memory.
+     */
+    //% block="record audio clips to $storage"
+    //% blockId="record_setRecordingStorage"
+    //% parts="microphone"
+    //% weight=20
+    //% help=record/set-recording-storage
+    export function setRecordingStorage(storage: AudioRecordingStorage): void {
+        eraseRecording();
+        setFlashStorage(storage === AudioRecordingStorage.Flash);
+    }
 }
\ No newline at end of file
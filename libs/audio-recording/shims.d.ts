@@ -72,6 +72,14 @@ declare namespace record {
      */
     //% shim=record::setBothSamples
     function setBothSamples(sampleRate: int32): void;
+
+    /**
+     * Choose whether clips are recorded compressed to flash, rather than to RAM. Clips stay in RAM
+     * if the flash log has the flash, if it holds data that is not an audio clip, or if the program
+     * leaves less than two pages of it.
+     */
+    //% shim=record::setFlashStorage
+    function setFlashStorage(flash: boolean): void;
 }
 
 // Auto-generated. Do not edit. Really.
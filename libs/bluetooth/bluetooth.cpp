@@ -77,6 +77,7 @@ namespace bluetooth {
     //% blockId=bluetooth_start_magnetometer_service block="bluetooth magnetometer service"
     //% parts="bluetooth" weight=85
     void startMagnetometerService() {    
+        loadCompassCalibration();
         new MicroBitMagnetometerService(*uBit.ble, uBit.compass); 
     }
 
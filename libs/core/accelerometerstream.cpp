@@ -0,0 +1,98 @@
+#include "pxt.h"
+
+#define ACCELEROMETER_STREAM_ID 9512
+#define ACCELEROMETER_STREAM_EVT_BLOCK 1
+
+#ifndef ACCELEROMETER_STREAM_BLOCKS
+#define ACCELEROMETER_STREAM_BLOCKS 4
+#endif
+
+namespace input {
+
+/**
+ * Packs every accelerometer sample into a ring of buffers as signed 16-bit little endian
+ * x, y, z triplets, from the accelerometer data update event, and raises an event each time
+ * a buffer is full.
+ */
+class AccelerometerStream : public BlockRing {
+  public:
+    AccelerometerStream()
+        : BlockRing(ACCELEROMETER_STREAM_BLOCKS, ACCELEROMETER_STREAM_ID,
+                    ACCELEROMETER_STREAM_EVT_BLOCK) {}
+
+    void onSample() {
+        if (!running)
+            return;
+#if MICROBIT_CODAL
+        Sample3D s = uBit.accelerometer.getSample();
+        int16_t xyz[3] = {(int16_t)s.x, (int16_t)s.y, (int16_t)s.z};
+#else
+        int16_t xyz[3] = {(int16_t)uBit.accelerometer.getX(), (int16_t)uBit.accelerometer.getY(),
+                          (int16_t)uBit.accelerometer.getZ()};
+#endif
+        write(xyz);
+    }
+};
+
+static AccelerometerStream *accelerometerStream;
+
+static void onAccelerometerUpdate(MicroBitEvent) {
+    accelerometerStream->onSample();
+}
+
+/**
+ * Streams accelerometer samples in the background, in blocks of packed signed 16-bit
+ * x, y, z values (milli-g). The rate is rounded to one the accelerometer supports.
+ * @param sampleRate samples per second, eg: 100
+ * @param samplesPerBlock number of samples in each block, eg: 32
+ */
+//% parts="accelerometer" advanced=true
+void startAccelerationStream(int sampleRate, int samplesPerBlock) {
+    if (!accelerometerStream) {
+        accelerometerStream = new AccelerometerStream();
+        uBit.messageBus.listen(MICROBIT_ID_ACCELEROMETER, MICROBIT_ACCELEROMETER_EVT_DATA_UPDATE,
+                               onAccelerometerUpdate, MESSAGE_BUS_LISTENER_IMMEDIATE);
+    }
+    sampleRate = max(1, sampleRate);
+    uBit.accelerometer.setPeriod(max(1, 1000 / sampleRate));
+    accelerometerStream->start(3 * sizeof(int16_t), max(1, min(samplesPerBlock, 1000)));
+    // make sure the accelerometer is running
+    uBit.accelerometer.getX();
+}
+
+/**
+ * Stops the accelerometer stream.
+ */
+//% parts="accelerometer" advanced=true
+void stopAccelerationStream() {
+    if (accelerometerStream)
+        accelerometerStream->stop();
+}
+
+/**
+ * Takes the oldest full block of samples from the accelerometer stream.
+ * @returns null if no block is available
+ */
+//% parts="accelerometer" advanced=true
+Buffer readAccelerationBlock() {
+    return accelerometerStream ? accelerometerStream->read() : NULL;
+}
+
+/**
+ * Runs code each time a block of accelerometer samples is ready.
+ * @param handler code to run, typically calling ``readAccelerationBlock``
+ */
+//% parts="accelerometer" advanced=true
+void onAccelerationBlock(Action handler) {
+    registerWithDal(ACCELEROMETER_STREAM_ID, ACCELEROMETER_STREAM_EVT_BLOCK, handler);
+}
+
+/**
+ * Gets the number of samples dropped because no block was free.
+ */
+//% parts="accelerometer" advanced=true
+int accelerationStreamOverruns() {
+    return accelerometerStream ? accelerometerStream->overruns : 0;
+}
+
+} // namespace input
@@ -1,11 +1,79 @@
 #include "pxt.h"
 
+// Cached strips stay allocated outside the GC heap, about 30 bytes per character; V1 only has
+// 16K of RAM, so it keeps a single short one.
+#ifndef TEXT_STRIP_CACHE_SIZE
+#if MICROBIT_CODAL
+#define TEXT_STRIP_CACHE_SIZE 4
+#else
+#define TEXT_STRIP_CACHE_SIZE 1
+#endif
+#endif
+
+// longer strings are rendered on every call rather than pinning a large strip in memory
+#ifndef TEXT_STRIP_CACHE_MAX_LENGTH
+#if MICROBIT_CODAL
+#define TEXT_STRIP_CACHE_MAX_LENGTH 32
+#else
+#define TEXT_STRIP_CACHE_MAX_LENGTH 8
+#endif
+#endif
 
 /**
  * Provides access to basic micro:bit functionality.
  */
 //% color=#1E90FF weight=116 icon="\uf00a"
 namespace basic {
+    struct TextStrip {
+      char *text;
+      int length;
+      ImageData *image;
+      uint32_t lastUsed;
+    };
+    static TextStrip textStrips[TEXT_STRIP_CACHE_SIZE];
+    static uint32_t textStripClock;
+
+    // One glyph plus one column of spacing per character.
+    static MicroBitImage renderTextStrip(const char *text, int len) {
+      const int stride = MICROBIT_FONT_WIDTH + 1;
+      MicroBitImage strip(len * stride, MICROBIT_FONT_HEIGHT);
+      strip.clear();
+      for (int i = 0; i < len; ++i)
+        strip.print(text[i], i * stride, 0);
+      return strip;
+    }
+
+    // Returns the rendered strip for the text, reusing the strip of a recently shown
+    // string with the same content (score, status messages...).
+    static MicroBitImage textStrip(String text) {
+      const char *data = text->getUTF8Data();
+      int len = text->getUTF8Size();
+      if (len > TEXT_STRIP_CACHE_MAX_LENGTH)
+        return renderTextStrip(data, len);
+
+      TextStrip *slot = &textStrips[0];
+      for (int i = 0; i < TEXT_STRIP_CACHE_SIZE; ++i) {
+        TextStrip *e = &textStrips[i];
+        if (e->image && e->length == len && memcmp(e->text, data, len) == 0) {
+          e->lastUsed = ++textStripClock;
+          return MicroBitImage(e->image);
+        }
+        if (!e->image || (slot->image && e->lastUsed < slot->lastUsed))
+          slot = e;
+      }
+
+      if (slot->image) {
+        slot->image->decr();
+        xfree(slot->text);
+      }
+      slot->text = (char *)xmalloc(len);
+      memcpy(slot->text, data, len);
+      slot->length = len;
+      slot->image = renderTextStrip(data, len).leakData();
+      slot->lastUsed = ++textStripClock;
+      return MicroBitImage(slot->image);
+    }
+
     /**
      * Draws an image on the LED screen.
      * @param leds the pattern of LED to turn on/off.
@@ -18,6 +86,7 @@ namespace basic {
     //% block="show leds" icon="\uf00a"
     //% parts="ledmatrix"
     void showLeds(ImageLiteral_ leds, int interval = 400) {
+      beginDisplayWrite();
       uBit.display.print(MicroBitImage(imageBytes(leds)), 0, 0, 0, interval);
     }
 
@@ -36,12 +105,14 @@ namespace basic {
     void showString(String text, int interval = 150) {
       if (interval <= 0)
         interval = 1;
+      beginDisplayWrite();
       int l = text ? text->getUTF8Size() : 0;
       if (l == 0) {
         uBit.display.clear();
         fiber_sleep(interval * 5);
       } else if (l > 1) {
-        uBit.display.scroll(MSTR(text), interval);
+        // clear the display as the last character leaves it, rather than scrolling a blank screen
+        uBit.display.animate(textStrip(text), interval, 1, MICROBIT_DISPLAY_ANIMATE_DEFAULT_POS, 1);
       } else {
         uBit.display.printChar(text->getUTF8Data()[0], interval * 5);
       }
@@ -54,6 +125,7 @@ namespace basic {
     //% blockId=device_clear_display block="clear screen"
     //% parts="ledmatrix"
     void clearScreen() {
+      beginDisplayWrite();
       uBit.display.image.clear();
     }
 
@@ -65,6 +137,7 @@ namespace basic {
     //% help=basic/show-animation imageLiteral=1 async
     //% parts="ledmatrix"
     void showAnimation(ImageLiteral_ leds, int interval = 400) {
+      beginDisplayWrite();
       uBit.display.animate(MicroBitImage(imageBytes(leds)), interval, 5, 0, 0);
     }
 
@@ -75,6 +148,7 @@ namespace basic {
     //% help=basic/plot-leds weight=80
     //% parts="ledmatrix"
     void plotLeds(ImageLiteral_ leds) {
+      beginDisplayWrite();
       MicroBitImage i(imageBytes(leds));
       uBit.display.print(i, 0, 0, 0, 0);
     }
@@ -0,0 +1,61 @@
+#include "pxt.h"
+
+namespace pxt {
+
+BlockRing::BlockRing(int numBlocks, int eventId, int eventValue)
+    : numBlocks(numBlocks), sampleSize(0), samplesPerBlock(0), writeBlock(0), writeSample(0),
+      readBlock(0), pending(0), overruns(0), running(false), eventId(eventId),
+      eventValue(eventValue) {
+    blocks = (Buffer *)xmalloc(numBlocks * sizeof(Buffer));
+    memset(blocks, 0, numBlocks * sizeof(Buffer));
+}
+
+void BlockRing::start(int sampleSize_, int samplesPerBlock_) {
+    running = false;
+    sampleSize = sampleSize_;
+    samplesPerBlock = samplesPerBlock_;
+    for (int i = 0; i < numBlocks; ++i) {
+        if (blocks[i])
+            unregisterGCObj(blocks[i]);
+        blocks[i] = mkBuffer(NULL, sampleSize * samplesPerBlock);
+        registerGCObj(blocks[i]);
+    }
+    writeBlock = writeSample = readBlock = pending = overruns = 0;
+    running = true;
+}
+
+void BlockRing::write(const void *sample) {
+    if (!running)
+        return;
+    if (pending == numBlocks) {
+        // the program is not keeping up; drop the sample rather than a full block
+        overruns++;
+        return;
+    }
+    memcpy(blocks[writeBlock]->data + writeSample * sampleSize, sample, sampleSize);
+    if (++writeSample == samplesPerBlock) {
+        writeSample = 0;
+        writeBlock = (writeBlock + 1) % numBlocks;
+        pending++;
+        MicroBitEvent(eventId, eventValue);
+    }
+}
+
+Buffer BlockRing::read() {
+    if (pending == 0)
+        return NULL;
+    // the writer never touches a full block, so it is safe to replace it; allocating may run
+    // the GC, so the old block stays pinned until the ring is patched up
+    Buffer b = blocks[readBlock];
+    Buffer fresh = mkBuffer(NULL, b->length);
+    registerGCObj(fresh);
+    unregisterGCObj(b);
+    __disable_irq();
+    blocks[readBlock] = fresh;
+    readBlock = (readBlock + 1) % numBlocks;
+    pending--;
+    __enable_irq();
+    return b;
+}
+
+} // namespace pxt
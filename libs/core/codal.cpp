@@ -56,12 +56,29 @@ void platform_init() {
     seedRandom(seed);
 }
 
+static int freeFlashUser;
+
+bool claimFreeFlash(int user) {
+    if (freeFlashUser && freeFlashUser != user)
+        return false;
+    freeFlashUser = user;
+    return true;
+}
+
 void initMicrobitGC() {
     uBit.init();
     if (device_heap_size(1) > NON_GC_HEAP_RESERVATION + 4)
         gcPreAllocateBlock(device_heap_size(1) - NON_GC_HEAP_RESERVATION);
 }
 
+SystemTickComponent::SystemTickComponent() {
+#if MICROBIT_CODAL
+    status |= DEVICE_COMPONENT_STATUS_SYSTEM_TICK;
+#else
+    uBit.addSystemComponent(this);
+#endif
+}
+
 void platform_init();
 void usb_init();
 
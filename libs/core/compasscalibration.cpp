@@ -0,0 +1,83 @@
+#include "pxt.h"
+
+#define COMPASS_CALIBRATION_KEY "pxtCompassCal"
+
+#if MICROBIT_CODAL
+#define COMPASS_EVT_CALIBRATION_REQUESTED COMPASS_EVT_CALIBRATE
+#else
+#define COMPASS_EVT_CALIBRATION_REQUESTED MICROBIT_COMPASS_EVT_CALIBRATE
+#endif
+
+namespace pxt {
+
+// 32 bytes, the largest value the key/value storage accepts. The storage does not keep the
+// size of a value, so the record carries its own, and only half of the serial number fits.
+struct StoredCompassCalibration {
+    uint16_t size;
+    uint16_t serial;
+    CompassCalibration calibration;
+};
+
+static uint16_t compassCalibrationSerial() {
+    uint32_t serial = microbit_serial_number();
+    return (serial >> 16) ^ serial;
+}
+
+static bool readStoredCompassCalibration(StoredCompassCalibration *stored) {
+    KeyValuePair *pair = uBit.storage.get(COMPASS_CALIBRATION_KEY);
+    if (!pair)
+        return false;
+    memcpy(stored, pair->value, sizeof(*stored));
+    delete pair;
+    // a record from an older version, or the storage page of another device that came along
+    // with a copied flash image
+    return stored->size == sizeof(*stored) && stored->serial == compassCalibrationSerial();
+}
+
+static void saveCompassCalibration() {
+    if (!uBit.compass.isCalibrated())
+        return;
+    StoredCompassCalibration stored, current;
+    current.size = sizeof(current);
+    current.serial = compassCalibrationSerial();
+    current.calibration = uBit.compass.getCalibration();
+    // avoid wearing out the flash when nothing changed
+    if (readStoredCompassCalibration(&stored) && !memcmp(&stored, &current, sizeof(current)))
+        return;
+    uBit.storage.put(COMPASS_CALIBRATION_KEY, (uint8_t *)&current, sizeof(current));
+}
+
+// the calibrator runs the interactive calibration from an immediate listener of the same
+// event; this queued listener waits for it to complete before persisting the result
+static void onCompassCalibrationRequested(MicroBitEvent) {
+    while (!uBit.compass.isCalibrated())
+        fiber_sleep(100);
+    saveCompassCalibration();
+}
+
+void loadCompassCalibration() {
+    static bool loaded;
+    if (loaded)
+        return;
+    loaded = true;
+    StoredCompassCalibration stored;
+    if (readStoredCompassCalibration(&stored))
+        uBit.compass.setCalibration(stored.calibration);
+    uBit.messageBus.listen(MICROBIT_ID_COMPASS, COMPASS_EVT_CALIBRATION_REQUESTED,
+                           onCompassCalibrationRequested);
+}
+
+} // namespace pxt
+
+namespace input {
+
+/**
+ * Forgets the compass calibration saved in flash, so that the compass is calibrated again
+ * after the next reset.
+ */
+//% parts="compass" advanced=true
+void clearCompassCalibration() {
+    uBit.storage.remove(COMPASS_CALIBRATION_KEY);
+}
+
+} // namespace input
@@ -0,0 +1,266 @@
+#include "pxt.h"
+
+#define CUSTOM_GESTURE_ID 9513
+
+#ifndef CUSTOM_GESTURE_MAX_TEMPLATES
+#define CUSTOM_GESTURE_MAX_TEMPLATES 8
+#endif
+
+// 64 samples at 50 Hz, so gestures up to 1.28 seconds
+#define CUSTOM_GESTURE_PERIOD 20
+#define CUSTOM_GESTURE_MAX_SAMPLES 64
+// match every 4 samples, i.e. 80ms
+#define CUSTOM_GESTURE_MATCH_EVERY 4
+
+namespace input {
+
+struct GestureTemplate {
+    int gesture;
+    int length;
+    int8_t xyz[CUSTOM_GESTURE_MAX_SAMPLES * 3];
+};
+
+/**
+ * Samples the accelerometer at 50 Hz into a history of scaled down int8 samples, and every
+ * few samples compares the most recent window against each recorded template with dynamic
+ * time warping, so a gesture still matches when performed a little faster or slower.
+ * The warping is limited to a band around the diagonal to keep each comparison linear in the
+ * template length, and windows with hardly any motion are skipped altogether. Sampling only
+ * runs while there is a gesture to record or to recognize.
+ */
+class CustomGestureRecognizer {
+  public:
+    GestureTemplate *templates[CUSTOM_GESTURE_MAX_TEMPLATES];
+    int8_t history[CUSTOM_GESTURE_MAX_SAMPLES * 3];
+    int head;
+    int count;
+    int sinceMatch;
+    int cooldown;
+    int tolerance;
+    GestureTemplate *recording;
+    // cleared by the fiber itself as it exits
+    bool running;
+
+    CustomGestureRecognizer()
+        : head(0), count(0), sinceMatch(0), cooldown(0), tolerance(12), recording(NULL),
+          running(false) {
+        memset(templates, 0, sizeof(templates));
+        memset(history, 0, sizeof(history));
+    }
+
+    static int8_t scale(int mg) {
+        int v = mg >> 5;
+        return v > 127 ? 127 : v < -128 ? -128 : v;
+    }
+
+    // i = 0 is the oldest sample of a window of n samples
+    const int8_t *sample(int n, int i) {
+        int k = head - n + i;
+        if (k < 0)
+            k += CUSTOM_GESTURE_MAX_SAMPLES;
+        return history + k * 3;
+    }
+
+    static int distance(const int8_t *a, const int8_t *b) {
+        return abs(a[0] - b[0]) + abs(a[1] - b[1]) + abs(a[2] - b[2]);
+    }
+
+    bool still(int n) {
+        int lo[3] = {127, 127, 127}, hi[3] = {-128, -128, -128};
+        for (int i = 0; i < n; ++i) {
+            const int8_t *s = sample(n, i);
+            for (int k = 0; k < 3; ++k) {
+                lo[k] = min(lo[k], (int)s[k]);
+                hi[k] = max(hi[k], (int)s[k]);
+            }
+        }
+        // less than about 200mg of movement on every axis
+        return hi[0] - lo[0] < 6 && hi[1] - lo[1] < 6 && hi[2] - lo[2] < 6;
+    }
+
+    // average per-sample cost of the best warping path
+    int dtw(GestureTemplate *t) {
+        int n = t->length;
+        int band = n / 8 + 1;
+        int rows[2][CUSTOM_GESTURE_MAX_SAMPLES + 1];
+        const int inf = 0x3fffffff;
+        for (int j = 0; j <= n; ++j)
+            rows[0][j] = inf;
+        rows[0][0] = 0;
+        for (int i = 1; i <= n; ++i) {
+            int *prev = rows[(i - 1) & 1];
+            int *cur = rows[i & 1];
+            for (int j = 0; j <= n; ++j)
+                cur[j] = inf;
+            int from = max(1, i - band), to = min(n, i + band);
+            const int8_t *s = sample(n, i - 1);
+            for (int j = from; j <= to; ++j) {
+                int best = min(prev[j - 1], min(prev[j], cur[j - 1]));
+                if (best < inf)
+                    cur[j] = best + distance(s, t->xyz + (j - 1) * 3);
+            }
+        }
+        return rows[n & 1][n] / n;
+    }
+
+    void match() {
+        GestureTemplate *best = NULL;
+        int bestScore = tolerance + 1;
+        for (int i = 0; i < CUSTOM_GESTURE_MAX_TEMPLATES; ++i) {
+            GestureTemplate *t = templates[i];
+            if (!t || t->length > count || still(t->length))
+                continue;
+            int score = dtw(t);
+            if (score < bestScore) {
+                bestScore = score;
+                best = t;
+            }
+        }
+        if (best) {
+            // don't report the same movement again while it slides through the window
+            cooldown = best->length;
+            MicroBitEvent(CUSTOM_GESTURE_ID, best->gesture);
+        }
+    }
+
+    void add(int x, int y, int z) {
+        int8_t *s = history + head * 3;
+        s[0] = scale(x), s[1] = scale(y), s[2] = scale(z);
+        head = (head + 1) % CUSTOM_GESTURE_MAX_SAMPLES;
+        if (count < CUSTOM_GESTURE_MAX_SAMPLES)
+            count++;
+
+        if (recording) {
+            if (recording->length < CUSTOM_GESTURE_MAX_SAMPLES)
+                memcpy(recording->xyz + recording->length++ * 3, s, 3);
+            return;
+        }
+        if (cooldown > 0) {
+            cooldown--;
+            return;
+        }
+        if (++sinceMatch >= CUSTOM_GESTURE_MATCH_EVERY) {
+            sinceMatch = 0;
+            match();
+        }
+    }
+
+    bool active() {
+        if (recording)
+            return true;
+        for (int i = 0; i < CUSTOM_GESTURE_MAX_TEMPLATES; ++i)
+            if (templates[i])
+                return true;
+        return false;
+    }
+
+    void run() {
+        while (active()) {
+#if MICROBIT_CODAL
+            Sample3D s = uBit.accelerometer.getSample();
+            add(s.x, s.y, s.z);
+#else
+            add(uBit.accelerometer.getX(), uBit.accelerometer.getY(), uBit.accelerometer.getZ());
+#endif
+            fiber_sleep(CUSTOM_GESTURE_PERIOD);
+        }
+        running = false;
+    }
+
+    int slot(int gesture, bool create) {
+        int free = -1;
+        for (int i = 0; i < CUSTOM_GESTURE_MAX_TEMPLATES; ++i) {
+            if (templates[i] && templates[i]->gesture == gesture)
+                return i;
+            if (!templates[i] && free < 0)
+                free = i;
+        }
+        return create ? free : -1;
+    }
+};
+
+static CustomGestureRecognizer *recognizer;
+
+static void customGestureFiber(void *) {
+    recognizer->run();
+}
+
+static CustomGestureRecognizer *getRecognizer() {
+    if (!recognizer)
+        recognizer = new CustomGestureRecognizer();
+    return recognizer;
+}
+
+// call once there is something to record or recognize
+static void startRecognizer() {
+    if (recognizer->running)
+        return;
+    // the history stopped when sampling did
+    recognizer->count = 0;
+    recognizer->running = true;
+    create_fiber(customGestureFiber, NULL);
+}
+
+/**
+ * Records a custom gesture from the accelerometer, replacing any previous recording with the
+ * same number. Blocks while recording; perform the gesture once during that time.
+ * @param gesture number identifying the gesture, from 1, eg: 1
+ * @param duration how long to record in milliseconds, up to 1280, eg: 800
+ */
+//% parts="accelerometer" advanced=true async
+void recordCustomGesture(int gesture, int duration) {
+    CustomGestureRecognizer *r = getRecognizer();
+    int i = r->slot(gesture, true);
+    if (i < 0 || r->recording)
+        return;
+    GestureTemplate *t = new GestureTemplate();
+    t->gesture = gesture;
+    t->length = 0;
+    r->recording = t;
+    startRecognizer();
+    fiber_sleep(min(duration, CUSTOM_GESTURE_PERIOD * CUSTOM_GESTURE_MAX_SAMPLES));
+    r->recording = NULL;
+    if (t->length < 2) {
+        delete t;
+        return;
+    }
+    delete r->templates[i];
+    r->templates[i] = t;
+    r->cooldown = t->length;
+}
+
+/**
+ * Forgets a recorded custom gesture.
+ * @param gesture number identifying the gesture, eg: 1
+ */
+//% parts="accelerometer" advanced=true
+void clearCustomGesture(int gesture) {
+    if (!recognizer)
+        return;
+    int i = recognizer->slot(gesture, false);
+    if (i >= 0) {
+        delete recognizer->templates[i];
+        recognizer->templates[i] = NULL;
+    }
+}
+
+/**
+ * Sets how different a movement may be from a recorded gesture and still match it.
+ * @param tolerance average difference allowed per sample, in units of 32mg per axis, eg: 12
+ */
+//% parts="accelerometer" advanced=true
+void setCustomGestureTolerance(int tolerance) {
+    getRecognizer()->tolerance = max(0, tolerance);
+}
+
+/**
+ * Runs code when a recorded custom gesture is recognized.
+ * @param gesture number identifying the gesture, eg: 1
+ * @param body code to run
+ */
+//% parts="accelerometer" advanced=true
+void onCustomGesture(int gesture, Action body) {
+    registerWithDal(CUSTOM_GESTURE_ID, gesture, body);
+}
+
+} // namespace input
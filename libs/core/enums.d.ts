@@ -25,6 +25,18 @@
     declare const enum PerfCounters {
     GC = 0,
     }
+
+
+    declare const enum ImageDrawMode {
+    //% block="copy"
+    Copy = 0,
+    //% block="or"
+    Or = 1,
+    //% block="xor"
+    Xor = 2,
+    //% block="max"
+    Max = 3,
+    }
 declare namespace images {
 }
 declare namespace basic {
@@ -194,6 +206,14 @@ declare namespace basic {
     //% block="4 up"
     _4Up = 16,  // MES_DPAD_BUTTON_4_UP
     }
+
+
+    declare const enum LightCondition {
+    //% block="dark"
+    Dark = 1,
+    //% block="bright"
+    Bright = 2,
+    }
 declare namespace input {
 }
 
@@ -421,12 +441,50 @@ declare namespace control {
     BackAndWhite = 0,  // DISPLAY_MODE_BLACK_AND_WHITE
     //% block="greyscale"
     Greyscale = 1,  // DISPLAY_MODE_GREYSCALE
+    //% block="dithered greyscale"
+    DitheredGreyscale = 16,  // DISPLAY_MODE_GREYSCALE_DITHERED
     // TODO DISPLAY_MODE_BLACK_AND_WHITE_LIGHT_SENSE
     }
 declare namespace led {
 }
 
 
+    declare const enum LedAnimationEvent {
+    //% block="done"
+    Done = 1,
+    //% block="cancelled"
+    Cancelled = 2,
+    //% block="looped"
+    Looped = 3,
+    }
+declare namespace led {
+}
+
+
+    declare const enum SampleFormat {
+    //% block="8 bit"
+    Int8 = 1,
+    //% block="16 bit"
+    Int16 = 2,
+    }
+declare namespace music {
+}
+
+
+    declare const enum SynthWaveform {
+    //% block="sine"
+    Sine = 0,
+    //% block="sawtooth"
+    Sawtooth = 1,
+    //% block="triangle"
+    Triangle = 2,
+    //% block="square"
+    Square = 3,
+    }
+declare namespace music {
+}
+
+
     declare const enum DigitalPin {
     P0 = 100,  // MICROBIT_ID_IO_P0
     P1 = 101,  // MICROBIT_ID_IO_P1
@@ -27,6 +27,68 @@ unsigned RefMImage::gcsize(RefMImage *t) {
     return (sizeof(*t) + 3) >> 2;
 }
 
+enum class ImageDrawMode {
+    //% block="copy"
+    Copy = 0,
+    //% block="or"
+    Or = 1,
+    //% block="xor"
+    Xor = 2,
+    //% block="max"
+    Max = 3,
+};
+
+// Combines a w x h rectangle of src at (sx, sy) into dst at (dx, dy), clipped to both images.
+// Rows and columns are walked so that overlapping regions of the same image are read
+// before they are overwritten.
+static void blitImageData(ImageData *dst, int dx, int dy, ImageData *src, int sx, int sy, int w,
+                          int h, ImageDrawMode mode) {
+    if (sx < 0) { w += sx; dx -= sx; sx = 0; }
+    if (sy < 0) { h += sy; dy -= sy; sy = 0; }
+    if (dx < 0) { w += dx; sx -= dx; dx = 0; }
+    if (dy < 0) { h += dy; sy -= dy; dy = 0; }
+    w = min_(w, min_(src->width - sx, dst->width - dx));
+    h = min_(h, min_(src->height - sy, dst->height - dy));
+    if (w <= 0 || h <= 0)
+        return;
+
+    int sw = src->width, dw = dst->width;
+    bool backwards = src == dst && (dy > sy || (dy == sy && dx > sx));
+    for (int r = 0; r < h; ++r) {
+        int y = backwards ? h - 1 - r : r;
+        const uint8_t *sp = src->data + (sy + y) * sw + sx;
+        uint8_t *dp = dst->data + (dy + y) * dw + dx;
+        switch (mode) {
+        case ImageDrawMode::Copy:
+            memmove(dp, sp, w);
+            break;
+        default:
+            for (int c = 0; c < w; ++c) {
+                int x = backwards ? w - 1 - c : c;
+                uint8_t v = sp[x];
+                if (mode == ImageDrawMode::Or)
+                    dp[x] |= v;
+                else if (mode == ImageDrawMode::Xor)
+                    dp[x] ^= v;
+                else if (v > dp[x])
+                    dp[x] = v;
+            }
+            break;
+        }
+    }
+}
+
+static void fillImageData(ImageData *dst, int x, int y, int w, int h, uint8_t value) {
+    if (x < 0) { w += x; x = 0; }
+    if (y < 0) { h += y; y = 0; }
+    w = min_(w, dst->width - x);
+    h = min_(h, dst->height - y);
+    if (w <= 0 || h <= 0)
+        return;
+    for (int r = y; r < y + h; ++r)
+        memset(dst->data + r * dst->width + x, value, w);
+}
+
 /**
  * Creation, manipulation and display of LED images.
  */
@@ -77,6 +139,7 @@ namespace ImageMethods {
 //% help=images/plot-image
 //% parts="ledmatrix"
 void plotImage(Image i, int xOffset = 0) {
+    beginDisplayWrite();
     uBit.display.print(MicroBitImage(i->img), -xOffset, 0, 0, 0);
 }
 
@@ -90,6 +153,7 @@ void plotImage(Image i, int xOffset = 0) {
 //% interval.defl=400
 //% blockGap=8 parts="ledmatrix" async
 void showImage(Image sprite, int xOffset, int interval = 400) {
+    beginDisplayWrite();
     uBit.display.print(MicroBitImage(sprite->img), -xOffset, 0, 0, interval);
 }
 
@@ -114,6 +178,7 @@ void plotFrame(Image i, int xOffset) {
 //% block="scroll image %sprite(myImage)|with offset %frameoffset|and interval (ms) %delay"
 //% blockGap=8 parts="ledmatrix"
 void scrollImage(Image id, int frameOffset, int interval) {
+    beginDisplayWrite();
     MicroBitImage i(id->img);
     uBit.display.animate(i, interval, frameOffset, MICROBIT_DISPLAY_ANIMATE_DEFAULT_POS, 0);
 }
@@ -189,6 +254,83 @@ bool pixel(Image i, int x, int y) {
     return pixelBrightness(i, x, y) > 0;
 }
 
+/**
+ * Draws another image on top of this one, clipping it to the bounds of this image.
+ * @param src image to draw
+ * @param x column of this image where the left edge of ``src`` goes
+ * @param y row of this image where the top edge of ``src`` goes
+ * @param mode how source pixels are combined with the existing pixels
+ */
+//% parts="ledmatrix"
+void drawImage(Image i, Image src, int x, int y, ImageDrawMode mode = ImageDrawMode::Copy) {
+    if (!src)
+        return;
+    i->makeWritable();
+    blitImageData(i->img, x, y, src->img, 0, 0, src->img->width, src->img->height, mode);
+}
+
+/**
+ * Copies a rectangle of another image (or of this image) into this image.
+ * @param src image to copy pixels from
+ * @param srcX left column of the rectangle in ``src``
+ * @param srcY top row of the rectangle in ``src``
+ * @param w width of the rectangle
+ * @param h height of the rectangle
+ * @param x destination column in this image
+ * @param y destination row in this image
+ */
+//% parts="ledmatrix"
+void copyRegion(Image i, Image src, int srcX, int srcY, int w, int h, int x, int y) {
+    if (!src)
+        return;
+    i->makeWritable();
+    blitImageData(i->img, x, y, src->img, srcX, srcY, w, h, ImageDrawMode::Copy);
+}
+
+/**
+ * Shifts the pixels of the image, turning off the pixels that are shifted in.
+ * @param dx columns to shift right, negative to shift left
+ * @param dy rows to shift down, negative to shift up
+ */
+//% parts="ledmatrix"
+void shift(Image i, int dx, int dy) {
+    i->makeWritable();
+    auto d = i->img;
+    int w = d->width, h = d->height;
+    blitImageData(d, dx, dy, d, 0, 0, w, h, ImageDrawMode::Copy);
+    if (dx > 0)
+        fillImageData(d, 0, 0, dx, h, 0);
+    else if (dx < 0)
+        fillImageData(d, w + dx, 0, -dx, h, 0);
+    if (dy > 0)
+        fillImageData(d, 0, 0, w, dy, 0);
+    else if (dy < 0)
+        fillImageData(d, 0, h + dy, w, -dy, 0);
+}
+
+/**
+ * Inverts the brightness of every pixel.
+ */
+//% parts="ledmatrix"
+void invert(Image i) {
+    i->makeWritable();
+    auto d = i->img;
+    uint8_t *p = d->data;
+    for (int n = d->width * d->height; n > 0; --n, ++p)
+        *p = 0xff - *p;
+}
+
+/**
+ * Sets every pixel to the given brightness.
+ * @param value brightness from 0 (off) to 255 (bright)
+ */
+//% parts="ledmatrix"
+void fill(Image i, int value) {
+    i->makeWritable();
+    auto d = i->img;
+    memset(d->data, max_(0, min_(0xff, value)), d->width * d->height);
+}
+
 /**
  * Show a particular frame of the image strip.
  * @param frame image frame to show
@@ -158,6 +158,15 @@ enum class MesDpadButtonInfo {
     _4Up = MES_DPAD_BUTTON_4_UP,
 };
 
+#define LIGHT_LEVEL_ID 9511
+
+enum class LightCondition {
+    //% block="dark"
+    Dark = 1,
+    //% block="bright"
+    Bright = 2,
+};
+
 //% color=#D400D4 weight=111 icon="\uf192"
 namespace input {
     /**
@@ -269,12 +278,13 @@ namespace input {
         return pin && pin->isTouched();
     }
 
-    int getAccelerationStrength() {
-        double x = uBit.accelerometer.getX();
-        double y = uBit.accelerometer.getY();
-        double z = uBit.accelerometer.getZ();
-        return (int)sqrt(x*x+y*y+z*z);
-    }
+    static int lightSamplePeriod;
+    static int lightSmoothing;
+    static bool lightSamplerRunning;
+    // smoothed light level in 8.8 fixed point, -1 until the first sample
+    static int lightLevelQ8 = -1;
+    static int lightThresholds[2] = {32, 200};
+    static int lightCondition;
 
     /**
      * Get the acceleration value in milli-gravitys (when the board is laying flat with the screen up, x=0, y=0 and z=-1024)
@@ -284,13 +294,7 @@ namespace input {
     //% blockId=device_acceleration block="acceleration (mg)|%NAME" blockGap=8
     //% parts="accelerometer"
     int acceleration(Dimension dimension) {
-      switch (dimension) {
-      case Dimension::X: return uBit.accelerometer.getX();
-      case Dimension::Y: return uBit.accelerometer.getY();
-      case Dimension::Z: return uBit.accelerometer.getZ();
-      case Dimension::Strength: return getAccelerationStrength();
-      }
-      return 0;
+      return sensorAcceleration((int)dimension);
     }
 
     /**
@@ -300,7 +304,81 @@ namespace input {
     //% blockId=device_get_light_level block="light level" blockGap=8
     //% parts="ledmatrix"
     int lightLevel() {
-        return uBit.display.readLightLevel();
+        if (lightSamplePeriod > 0 && lightLevelQ8 >= 0)
+            return lightLevelQ8 >> 8;
+        return readLightLevelKeepingMode();
+    }
+
+    static void lightLevelSampler() {
+        while (lightSamplePeriod > 0) {
+            // reading the light level switches the display to black and white, which would
+            // break greyscale images, plots, animations and the dithered mode; wait for the
+            // display to leave greyscale instead, keeping the last level
+            if (uBit.display.getDisplayMode() == DISPLAY_MODE_GREYSCALE) {
+                fiber_sleep(lightSamplePeriod);
+                continue;
+            }
+            int v = uBit.display.readLightLevel() << 8;
+            if (lightLevelQ8 < 0)
+                lightLevelQ8 = v;
+            else
+                lightLevelQ8 += (v - lightLevelQ8) * (100 - lightSmoothing) / 100;
+
+            int level = lightLevelQ8 >> 8;
+            if (level <= lightThresholds[0] && lightCondition != (int)LightCondition::Dark) {
+                lightCondition = (int)LightCondition::Dark;
+                MicroBitEvent(LIGHT_LEVEL_ID, lightCondition);
+            } else if (level >= lightThresholds[1] && lightCondition != (int)LightCondition::Bright) {
+                lightCondition = (int)LightCondition::Bright;
+                MicroBitEvent(LIGHT_LEVEL_ID, lightCondition);
+            }
+            fiber_sleep(lightSamplePeriod);
+        }
+        lightSamplerRunning = false;
+    }
+
+    /**
+     * Samples the light level in the background and keeps a smoothed value, so that
+     * ``light level`` returns immediately. Use a period of 0 to stop sampling.
+     * Sampling pauses while the screen shows greyscale, since measuring light turns it black and white.
+     * @param period time between two samples in milliseconds, eg: 100
+     * @param smoothing how much of the previous value is kept on each sample, from 0 (none) to 99 percent, eg: 80
+     */
+    //% parts="ledmatrix" advanced=true
+    void setLightLevelSampling(int period, int smoothing = 80) {
+        lightSamplePeriod = max(0, period);
+        lightSmoothing = max(0, min(99, smoothing));
+        if (lightSamplePeriod == 0) {
+            lightLevelQ8 = -1;
+            return;
+        }
+        if (!lightSamplerRunning) {
+            lightSamplerRunning = true;
+            create_fiber(lightLevelSampler);
+        }
+    }
+
+    /**
+     * Runs code when the smoothed light level crosses the dark or bright threshold.
+     * Starts background sampling if needed.
+     * @param condition the condition to detect
+     * @param handler code to run
+     */
+    //% parts="ledmatrix" advanced=true
+    void onLightCondition(LightCondition condition, Action handler) {
+        if (lightSamplePeriod == 0)
+            setLightLevelSampling(100);
+        registerWithDal(LIGHT_LEVEL_ID, (int)condition, handler);
+    }
+
+    /**
+     * Sets the light level below which it is dark, or above which it is bright.
+     * @param condition the threshold to change
+     * @param value light level from 0 (dark) to 255 (bright)
+     */
+    //% parts="ledmatrix" advanced=true
+    void setLightThreshold(LightCondition condition, int value) {
+        lightThresholds[condition == LightCondition::Dark ? 0 : 1] = max(0, min(0xff, value));
     }
 
     /**
@@ -311,7 +389,7 @@ namespace input {
     //% blockId=device_heading block="compass heading (°)" blockGap=8
     //% parts="compass"
     int compassHeading() {
-        return uBit.compass.heading();
+        return sensorCompassHeading();
     }
 
 
@@ -323,7 +401,7 @@ namespace input {
     //% blockId=device_temperature block="temperature (°C)" blockGap=8
     //% parts="thermometer"
     int temperature() {
-        return uBit.thermometer.getTemperature();
+        return sensorTemperature();
     }
 
     /**
@@ -334,11 +412,7 @@ namespace input {
     //% blockId=device_get_rotation block="rotation (°)|%NAME" blockGap=8
     //% parts="accelerometer" advanced=true
     int rotation(Rotation kind) {
-      switch (kind) {
-      case Rotation::Pitch: return uBit.accelerometer.getPitch();
-      case Rotation::Roll: return uBit.accelerometer.getRoll();
-      }
-      return 0;
+      return sensorRotation((int)kind);
     }
 
     /**
@@ -354,13 +428,7 @@ namespace input {
         if (!uBit.compass.isCalibrated())
             uBit.compass.calibrate();
         */
-        double d = 0;        
-        switch (dimension) {
-            case Dimension::X: d = uBit.compass.getX(); break;
-            case Dimension::Y: d = uBit.compass.getY(); break;
-            case Dimension::Z: d = uBit.compass.getZ(); break;
-            case Dimension::Strength: d = uBit.compass.getFieldStrength() ; break;
-        }
+        double d = sensorMagneticForce((int)dimension);
         return fromDouble(d / 1000.0);
     }
 
@@ -371,6 +439,7 @@ namespace input {
     //% blockId="input_compass_calibrate" block="calibrate compass"
     //% weight=55
     void calibrateCompass() {
+        loadCompassCalibration();
         uBit.compass.calibrate();
     }
 
@@ -1,5 +1,8 @@
 #include "pxt.h"
 
+// not a DAL mode: greyscale plus the dithering driver below
+#define DISPLAY_MODE_GREYSCALE_DITHERED 16
+
 enum class DisplayMode_ {
     //% block="black and white"
     BlackAndWhite = DISPLAY_MODE_BLACK_AND_WHITE,
@@ -7,11 +10,122 @@ enum class DisplayMode_ {
     BackAndWhite = DISPLAY_MODE_BLACK_AND_WHITE,
     //% block="greyscale"
     Greyscale = DISPLAY_MODE_GREYSCALE,
+    //% block="dithered greyscale"
+    DitheredGreyscale = DISPLAY_MODE_GREYSCALE_DITHERED,
     // TODO DISPLAY_MODE_BLACK_AND_WHITE_LIGHT_SENSE
 };
 
+/**
+ * Adds up to 8 bits of brightness below the 8 bits of the display driver by temporal
+ * dithering: on every system tick, each pixel shows its brightness rounded down or up, with a
+ * first order error accumulator picking the rounding so that the average matches.
+ * Pixels written through the regular 8-bit APIs are picked up as they are, so text, images
+ * and plots keep working in this mode.
+ */
+class DitherDriver : public SystemTickComponent {
+  public:
+    uint16_t target[25];
+    uint8_t out[25];
+    uint16_t acc[25];
+    uint8_t bits;
+    uint8_t divider;
+    uint8_t ticks;
+    volatile bool enabled;
+    // microseconds spent in the last update, and in the longest one since the mode started
+    uint32_t lastCost;
+    uint32_t maxCost;
+
+    DitherDriver() : bits(4), divider(1), ticks(0), enabled(false), lastCost(0), maxCost(0) {
+        memset(acc, 0, sizeof(acc));
+    }
+
+    void enable() {
+        if (enabled)
+            return;
+        const uint8_t *img = uBit.display.image.getBitmap();
+        for (int i = 0; i < 25; ++i) {
+            out[i] = img[i];
+            target[i] = img[i] << 8;
+        }
+        memset(acc, 0, sizeof(acc));
+        lastCost = maxCost = 0;
+        enabled = true;
+    }
+
+    // drops the extra bits of a pixel about to be written with an 8-bit value, which the
+    // tick below cannot tell from its own output when the two are equal
+    void reset(int i) {
+        target[i] = out[i] << 8;
+        acc[i] = 0;
+    }
+
+    virtual void tick() override {
+        if (!enabled || ++ticks < divider)
+            return;
+        ticks = 0;
+
+        uint32_t start = (uint32_t)system_timer_current_time_us();
+        uint8_t *img = uBit.display.image.getBitmap();
+        int one = 1 << bits;
+        int shift = 8 - bits;
+        for (int i = 0; i < 25; ++i) {
+            // written by someone else since the last tick
+            if (img[i] != out[i]) {
+                target[i] = img[i] << 8;
+                acc[i] = 0;
+            }
+            int v = target[i] >> 8;
+            acc[i] += (target[i] & 0xff) >> shift;
+            if (acc[i] >= one) {
+                acc[i] -= one;
+                if (v < 0xff)
+                    v++;
+            }
+            out[i] = img[i] = v;
+        }
+        lastCost = (uint32_t)system_timer_current_time_us() - start;
+        if (lastCost > maxCost)
+            maxCost = lastCost;
+    }
+};
+
+static DitherDriver *ditherDriver;
+
+static DitherDriver *getDitherDriver() {
+    if (!ditherDriver)
+        ditherDriver = new DitherDriver();
+    return ditherDriver;
+}
+
+namespace pxt {
+
+int readLightLevelKeepingMode() {
+    int level = uBit.display.readLightLevel();
+    // reading switched the display to black and white; the dither driver kept its targets
+    if (ditherDriver && ditherDriver->enabled)
+        uBit.display.setDisplayMode(DISPLAY_MODE_GREYSCALE);
+    return level;
+}
+
+void beginDisplayWrite(int x, int y) {
+    stopLedAnimation();
+    if (!ditherDriver || !ditherDriver->enabled)
+        return;
+    __disable_irq();
+    if (x < 0) {
+        for (int i = 0; i < 25; ++i)
+            ditherDriver->reset(i);
+    } else if (x < 5 && y >= 0 && y < 5) {
+        ditherDriver->reset(y * 5 + x);
+    }
+    __enable_irq();
+}
+
+} // namespace pxt
+
 //% color=#7600A8 weight=101 icon="\uf205"
 namespace led {
+    void cancelAnimation();
 
     /**
      * Turn on the specified LED using x, y coordinates (x is horizontal, y is vertical). (0,0) is upper left.
@@ -24,6 +138,7 @@ namespace led {
     //% x.min=0 x.max=4 y.min=0 y.max=4
     //% x.fieldOptions.precision=1 y.fieldOptions.precision=1
     void plot(int x, int y) {
+      beginDisplayWrite(x, y);
       uBit.display.image.setPixelValue(x, y, 0xff);
     }
 
@@ -40,6 +155,7 @@ namespace led {
     //% x.fieldOptions.precision=1 y.fieldOptions.precision=1
     //% advanced=true
     void plotBrightness(int x, int y, int brightness) {
+        beginDisplayWrite(x, y);
         brightness = max(0, min(0xff, brightness));
         // enable greyscale as needed
         if (brightness != 0 && brightness != 0xff && uBit.display.getDisplayMode() != DISPLAY_MODE_GREYSCALE)
@@ -47,6 +163,35 @@ namespace led {
         uBit.display.image.setPixelValue(x, y, brightness);
     }
 
+    /**
+     * Sets the brightness of every LED at once from a buffer of 25 bytes, row by row.
+     * The frame is swapped in between two refreshes so the screen never shows a partial update.
+     * @param frame brightness of each LED from 0 (off) to 255 (bright), row by row
+     */
+    //% parts="ledmatrix"
+    //% advanced=true
+    void setFrame(Buffer frame) {
+        if (!frame)
+            return;
+        beginDisplayWrite();
+        MicroBitImage &image = uBit.display.image;
+        int len = min_(frame->length, image.getWidth() * image.getHeight());
+        // enable greyscale at most once for the whole frame
+        if (uBit.display.getDisplayMode() != DISPLAY_MODE_GREYSCALE) {
+            for (int i = 0; i < len; ++i) {
+                uint8_t v = frame->data[i];
+                if (v != 0 && v != 0xff) {
+                    uBit.display.setDisplayMode(DISPLAY_MODE_GREYSCALE);
+                    break;
+                }
+            }
+        }
+        // the refresh interrupt reads the image row by row, keep it out while copying
+        __disable_irq();
+        memcpy(image.getBitmap(), frame->data, len);
+        __enable_irq();
+    }
+
     /**
      * Turn off the specified LED using x, y coordinates (x is horizontal, y is vertical). (0,0) is upper left.
      * @param x the horizontal coordinate of the LED
@@ -58,6 +203,7 @@ namespace led {
     //% x.min=0 x.max=4 y.min=0 y.max=4
     //% x.fieldOptions.precision=1 y.fieldOptions.precision=1
     void unplot(int x, int y) {
+      beginDisplayWrite(x, y);
       uBit.display.image.setPixelValue(x, y, 0);
     }
 
@@ -108,6 +254,7 @@ namespace led {
     //% parts="ledmatrix"
     //% advanced=true
     void stopAnimation() {
+       cancelAnimation();
        uBit.display.stopAnimation();
     }
 
@@ -119,6 +266,13 @@ namespace led {
     //% parts="ledmatrix" advanced=true weight=1
     //% blockId="led_set_display_mode" block="set display mode $mode"
     void setDisplayMode(DisplayMode_ mode) {
+        if (mode == DisplayMode_::DitheredGreyscale) {
+            uBit.display.setDisplayMode(DISPLAY_MODE_GREYSCALE);
+            getDitherDriver()->enable();
+            return;
+        }
+        if (ditherDriver)
+            ditherDriver->enabled = false;
         uBit.display.setDisplayMode((DisplayMode)mode);
     }
 
@@ -127,9 +281,56 @@ namespace led {
     */
     //% weight=1 parts="ledmatrix" advanced=true
     DisplayMode_ displayMode() {
+        if (ditherDriver && ditherDriver->enabled)
+            return DisplayMode_::DitheredGreyscale;
         return (DisplayMode_)uBit.display.getDisplayMode();
     }
 
+    /**
+     * Sets the brightness of every LED from a buffer of 25 unsigned 16-bit little endian
+     * numbers, row by row, and switches to the dithered greyscale mode.
+     * @param frame brightness of each LED from 0 (off) to 65535 (bright), row by row
+     */
+    //% parts="ledmatrix" advanced=true
+    void setFrameDithered(Buffer frame) {
+        if (!frame)
+            return;
+        stopLedAnimation();
+        setDisplayMode(DisplayMode_::DitheredGreyscale);
+        auto d = ditherDriver;
+        int len = min_(frame->length >> 1, 25);
+        __disable_irq();
+        memcpy(d->target, frame->data, len * sizeof(uint16_t));
+        __enable_irq();
+    }
+
+    /**
+     * Configures the dithered greyscale mode. The dithering runs on the system tick, every few
+     * milliseconds, so the dimmest extra levels repeat only every 2^bits updates and may flicker.
+     * @param bits extra brightness bits below the 8 bits of the display, from 1 to 8; more bits
+     * give smoother dimming but a slower (possibly visible) modulation of the dimmest levels, eg: 4
+     * @param divider number of system ticks between two updates; higher values use less CPU, eg: 1
+     */
+    //% parts="ledmatrix" advanced=true
+    void setDitherOptions(int bits, int divider) {
+        auto d = getDitherDriver();
+        d->bits = max_(1, min_(8, bits));
+        d->divider = max_(1, min_(0xff, divider));
+        memset(d->acc, 0, sizeof(d->acc));
+    }
+
+    /**
+     * Gets the time the dithered greyscale mode spent in its last update, or in its longest one
+     * since the mode started, in microseconds. Updates run in the system tick interrupt.
+     * @param longest whether to return the longest update rather than the last one
+     */
+    //% parts="ledmatrix" advanced=true
+    int ditherUpdateCost(bool longest = false) {
+        if (!ditherDriver)
+            return 0;
+        return longest ? ditherDriver->maxCost : ditherDriver->lastCost;
+    }
+
     /**
     * Turns on or off the display
     */
@@ -0,0 +1,213 @@
+#include "pxt.h"
+
+#define LED_ANIMATION_ID 9510
+
+enum class LedAnimationEvent {
+    //% block="done"
+    Done = 1,
+    //% block="cancelled"
+    Cancelled = 2,
+    //% block="looped"
+    Looped = 3,
+};
+
+namespace led {
+
+/**
+ * Plays a strip of 5x5 frames on the display from the system tick interrupt, so that no
+ * fiber has to wait for (or drive) the animation.
+ * Buffers are only allocated and released from fibers; the interrupt just reads them.
+ */
+class LedAnimator : public SystemTickComponent {
+  public:
+    ImageData *frames;
+    uint16_t *durations;
+    int numDurations;
+    int numFrames;
+    int frame;
+    uint32_t frameStart;
+    bool loop;
+    bool ease;
+    volatile bool playing;
+
+    LedAnimator()
+        : frames(NULL), durations(NULL), numDurations(0), numFrames(0), frame(0), frameStart(0),
+          loop(false), ease(false), playing(false) {}
+
+    int duration(int i) { return durations[i < numDurations ? i : numDurations - 1]; }
+
+    const uint8_t *frameData(int i) { return frames->data + i * 5; }
+
+    // frames are stored side by side in the strip, so rows are `frames->width` apart
+    void render(const uint8_t *from, const uint8_t *to, int t) {
+        uint8_t *dst = uBit.display.image.getBitmap();
+        int stride = frames->width;
+        for (int y = 0; y < 5; ++y) {
+            for (int x = 0; x < 5; ++x) {
+                int a = from[y * stride + x];
+                int b = to[y * stride + x];
+                *dst++ = a + (((b - a) * t) >> 8);
+            }
+        }
+    }
+
+    void finish(LedAnimationEvent ev) {
+        playing = false;
+        MicroBitEvent(LED_ANIMATION_ID, (int)ev);
+    }
+
+    virtual void tick() override {
+        if (!playing)
+            return;
+
+        uint32_t now = system_timer_current_time();
+        uint32_t elapsed = now - frameStart;
+        int d = duration(frame);
+        bool entered = false;
+        while (elapsed >= (uint32_t)d) {
+            elapsed -= d;
+            frameStart += d;
+            if (++frame >= numFrames) {
+                if (!loop) {
+                    render(frameData(numFrames - 1), frameData(numFrames - 1), 0);
+                    finish(LedAnimationEvent::Done);
+                    return;
+                }
+                frame = 0;
+                MicroBitEvent(LED_ANIMATION_ID, (int)LedAnimationEvent::Looped);
+            }
+            entered = true;
+            d = duration(frame);
+        }
+
+        if (ease) {
+            int next = frame + 1 < numFrames ? frame + 1 : loop ? 0 : frame;
+            // smoothstep in 8 bit fixed point
+            int t = (elapsed << 8) / d;
+            t = (t * t * (768 - 2 * t)) >> 16;
+            render(frameData(frame), frameData(next), t);
+        } else if (entered) {
+            render(frameData(frame), frameData(frame), 0);
+        }
+    }
+
+    // must be called from a fiber
+    void release() {
+        if (frames) {
+            frames->decr();
+            frames = NULL;
+        }
+        xfree(durations);
+        durations = NULL;
+    }
+
+    void start(ImageData *img, Buffer ms, bool loop_, bool ease_) {
+        stop(false);
+        release();
+
+        numFrames = img->width / 5;
+        if (numFrames == 0)
+            return;
+
+        numDurations = ms && ms->length >= 2 ? ms->length >> 1 : 1;
+        durations = (uint16_t *)xmalloc(numDurations * sizeof(uint16_t));
+        if (ms && ms->length >= 2)
+            memcpy(durations, ms->data, numDurations * sizeof(uint16_t));
+        else
+            durations[0] = 400;
+        // a zero duration would spin the interrupt forever on a looping animation
+        for (int i = 0; i < numDurations; ++i)
+            if (durations[i] == 0)
+                durations[i] = 1;
+
+        img->incr();
+        frames = img;
+        loop = loop_;
+        ease = ease_;
+
+        bool grey = ease;
+        for (int i = 0; !grey && i < img->width * img->height; ++i)
+            grey = img->data[i] != 0 && img->data[i] != 0xff;
+        if (grey && uBit.display.getDisplayMode() != DISPLAY_MODE_GREYSCALE)
+            uBit.display.setDisplayMode(DISPLAY_MODE_GREYSCALE);
+
+        uBit.display.stopAnimation();
+        frame = 0;
+        frameStart = system_timer_current_time();
+        render(frameData(0), frameData(0), 0);
+        playing = true;
+    }
+
+    void stop(bool notify) {
+        if (!playing)
+            return;
+        __disable_irq();
+        bool wasPlaying = playing;
+        playing = false;
+        __enable_irq();
+        if (wasPlaying && notify)
+            MicroBitEvent(LED_ANIMATION_ID, (int)LedAnimationEvent::Cancelled);
+    }
+};
+
+static LedAnimator *animator;
+
+static LedAnimator *getAnimator() {
+    if (!animator)
+        animator = new LedAnimator();
+    return animator;
+}
+
+/**
+ * Plays the frames of an image strip in the background, without blocking the calling code.
+ * Anything else drawn on the screen cancels it.
+ * @param frames image made of 5x5 frames side by side
+ * @param durations how long each frame is shown in milliseconds, as unsigned 16-bit little
+ * endian numbers; the last duration is used for the remaining frames
+ * @param loop whether to restart from the first frame after the last one
+ * @param ease whether to fade the brightness from each frame into the next one
+ */
+//% parts="ledmatrix" advanced=true
+void playAnimation(Image frames, Buffer durations, bool loop = false, bool ease = false) {
+    if (!frames)
+        return;
+    getAnimator()->start(frames->img, durations, loop, ease);
+}
+
+/**
+ * Stops the background animation started with ``playAnimation``.
+ */
+//% parts="ledmatrix" advanced=true
+void cancelAnimation() {
+    if (animator)
+        animator->stop(true);
+}
+
+/**
+ * Tells whether a background animation is playing.
+ */
+//% parts="ledmatrix" advanced=true
+bool isAnimationPlaying() {
+    return animator && animator->playing;
+}
+
+/**
+ * Runs code when the background animation completes, loops or is cancelled.
+ * @param event the animation event to listen for
+ * @param body code to run
+ */
+//% parts="ledmatrix" advanced=true
+void onAnimationEvent(LedAnimationEvent event, Action body) {
+    registerWithDal(LED_ANIMATION_ID, (int)event, body);
+}
+
+} // namespace led
+
+namespace pxt {
+
+void stopLedAnimation() {
+    if (led::animator)
+        led::animator->stop(true);
+}
+
+} // namespace pxt
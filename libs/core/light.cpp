@@ -63,6 +63,54 @@ neopixel_send_buffer_brightness(DevicePin &pin, const uint8_t *ptr, int numBytes
 }
 #endif
 
+namespace pins {
+SPI *allocSPI();
+}
+
+// APA102/SK9822 frame: 32 zero bits, one 32-bit word per LED (0b111, 5-bit global
+// brightness, blue, green, red), then zeros; the SK9822 needs the extra 32 bits to latch
+// and the APA102 needs at least one more clock edge per two LEDs to shift the data out.
+static uint8_t *apa102Frame;
+static unsigned apa102FrameSize;
+
+static void apa102_send_buffer(const uint8_t *ptr, int numBytes, int br) {
+    int numLeds = numBytes / 3;
+    unsigned size = 4 + numLeds * 4 + 4 + ((numLeds + 15) >> 4);
+
+    br = max_(0, min_(0xff, br));
+    int gbr = (br * 31 + 127) / 255;
+    if (br && !gbr)
+        gbr = 1;
+
+    // keep the frame around so that refreshing a strip does not allocate
+    if (size > apa102FrameSize) {
+        xfree(apa102Frame);
+        apa102Frame = (uint8_t *)xmalloc(size);
+        apa102FrameSize = size;
+    }
+
+    uint8_t *dst = apa102Frame;
+    memset(dst, 0, 4);
+    dst += 4;
+    for (int i = 0; i < numLeds; ++i) {
+        *dst++ = 0xe0 | gbr;
+        *dst++ = ptr[2];
+        *dst++ = ptr[1];
+        *dst++ = ptr[0];
+        ptr += 3;
+    }
+    memset(dst, 0, apa102Frame + size - dst);
+
+    auto spi = pins::allocSPI();
+#if MICROBIT_CODAL
+    // single EasyDMA transfer, interrupts stay enabled
+    spi->transfer(apa102Frame, size, NULL, 0);
+#else
+    for (unsigned i = 0; i < size; ++i)
+        spi->write(apa102Frame[i]);
+#endif
+}
+
 namespace light {
 
 /**
@@ -86,6 +134,19 @@ void sendWS2812BufferWithBrightness(Buffer buf, int pin, int brightness) {
     neopixel_send_buffer_brightness(*pxt::getPin(pin), buf->data, buf->length, brightness);
 }
 
+/**
+ * Sends a color buffer of RGB triplets to an APA102 or SK9822 strip over the SPI bus
+ * configured with ``pins.spiPins`` and ``pins.spiFrequency``.
+ * @param brightness global brightness from 0 (off) to 255, applied by the LEDs
+ **/
+//% advanced=true
+void sendAPA102Buffer(Buffer buf, int brightness) {
+    if (!buf || !buf->length)
+        return;
+
+    apa102_send_buffer(buf->data, buf->length, brightness);
+}
+
 /**
  * Sets the light mode of a pin
  **/
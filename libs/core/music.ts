@@ -522,6 +522,9 @@ namespace music {
         rest(0);
         stopMelody(MelodyStopOptions.All);
         music.__stopSoundExpressions();
+        music.stopSample(-1);
+        music.stopTrack(-1);
+        music.synthAllNotesOff();
         _stopPlayables();
         if (stopSoundHandlers) {
             for (const handler of stopSoundHandlers) {
@@ -0,0 +1,207 @@
+#include "pxt.h"
+#include <math.h>
+
+#define ORIENTATION_WARMUP_STEPS 200
+
+namespace input {
+
+/**
+ * Mahony filter fusing the accelerometer and the magnetometer into an orientation quaternion,
+ * run from a fiber at a fixed rate. Both sensors are read in the north-east-down frame.
+ * The board has no gyroscope, so the angular rate is zero and the filter reduces to a
+ * proportional correction towards the measured gravity and magnetic field, which smooths out
+ * the jitter of the raw readings. Angles are derived once per update, so reads are O(1), with
+ * the integer angle kernels. The filter itself is in float, which V1 runs in software as it has
+ * no floating point unit, so keep the rate low there.
+ */
+class OrientationFusion {
+  public:
+    float q0, q1, q2, q3;
+    float twoKp;
+    int period;
+    uint32_t lastUpdate;
+    int heading, pitch, roll;
+    // asked to run, and whether the fiber is still running; only the fiber clears the latter,
+    // so that a stop and start while it sleeps does not start a second one
+    bool running;
+    bool fiberRunning;
+
+    OrientationFusion()
+        : q0(1), q1(0), q2(0), q3(0), twoKp(2), period(0), lastUpdate(0), heading(0), pitch(0),
+          roll(0), running(false), fiberRunning(false) {}
+
+    void read(float *a, float *m) {
+#if MICROBIT_CODAL
+        Sample3D sa = uBit.accelerometer.getSample(NORTH_EAST_DOWN);
+        Sample3D sm = uBit.compass.getSample(NORTH_EAST_DOWN);
+        a[0] = sa.x, a[1] = sa.y, a[2] = sa.z;
+        m[0] = sm.x, m[1] = sm.y, m[2] = sm.z;
+#else
+        a[0] = uBit.accelerometer.getX(NORTH_EAST_DOWN);
+        a[1] = uBit.accelerometer.getY(NORTH_EAST_DOWN);
+        a[2] = uBit.accelerometer.getZ(NORTH_EAST_DOWN);
+        m[0] = uBit.compass.getX(NORTH_EAST_DOWN);
+        m[1] = uBit.compass.getY(NORTH_EAST_DOWN);
+        m[2] = uBit.compass.getZ(NORTH_EAST_DOWN);
+#endif
+    }
+
+    static bool normalize(float *v) {
+        float n = v[0] * v[0] + v[1] * v[1] + v[2] * v[2];
+        if (n == 0)
+            return false;
+        n = 1.0f / sqrtf(n);
+        v[0] *= n, v[1] *= n, v[2] *= n;
+        return true;
+    }
+
+    void step(const float *a, const float *m, float dt) {
+        float ax = a[0], ay = a[1], az = a[2];
+        float mx = m[0], my = m[1], mz = m[2];
+
+        float q0q0 = q0 * q0, q0q1 = q0 * q1, q0q2 = q0 * q2, q0q3 = q0 * q3;
+        float q1q1 = q1 * q1, q1q2 = q1 * q2, q1q3 = q1 * q3;
+        float q2q2 = q2 * q2, q2q3 = q2 * q3, q3q3 = q3 * q3;
+
+        // reference direction of the earth's magnetic field
+        float hx = 2.0f * (mx * (0.5f - q2q2 - q3q3) + my * (q1q2 - q0q3) + mz * (q1q3 + q0q2));
+        float hy = 2.0f * (mx * (q1q2 + q0q3) + my * (0.5f - q1q1 - q3q3) + mz * (q2q3 - q0q1));
+        float bx = sqrtf(hx * hx + hy * hy);
+        float bz = 2.0f * (mx * (q1q3 - q0q2) + my * (q2q3 + q0q1) + mz * (0.5f - q1q1 - q2q2));
+
+        // estimated directions of gravity and of the magnetic field
+        float vx = q1q3 - q0q2;
+        float vy = q0q1 + q2q3;
+        float vz = q0q0 - 0.5f + q3q3;
+        float wx = bx * (0.5f - q2q2 - q3q3) + bz * (q1q3 - q0q2);
+        float wy = bx * (q1q2 - q0q3) + bz * (q0q1 + q2q3);
+        float wz = bx * (q0q2 + q1q3) + bz * (0.5f - q1q1 - q2q2);
+
+        // error between estimated and measured directions, fed back as an angular rate
+        float gx = twoKp * ((ay * vz - az * vy) + (my * wz - mz * wy));
+        float gy = twoKp * ((az * vx - ax * vz) + (mz * wx - mx * wz));
+        float gz = twoKp * ((ax * vy - ay * vx) + (mx * wy - my * wx));
+
+        gx *= 0.5f * dt, gy *= 0.5f * dt, gz *= 0.5f * dt;
+        float qa = q0, qb = q1, qc = q2;
+        q0 += -qb * gx - qc * gy - q3 * gz;
+        q1 += qa * gx + qc * gz - q3 * gy;
+        q2 += qa * gy - qb * gz + q3 * gx;
+        q3 += qa * gz + qb * gy - qc * gx;
+
+        float n = 1.0f / sqrtf(q0 * q0 + q1 * q1 + q2 * q2 + q3 * q3);
+        q0 *= n, q1 *= n, q2 *= n, q3 *= n;
+    }
+
+    static int q15(float v) { return (int)(v * 32768); }
+
+    void updateAngles() {
+        roll = atan2Degrees(q15(q0 * q1 + q2 * q3), q15(0.5f - q1 * q1 - q2 * q2));
+        pitch = asinDegrees(q15(-2.0f * (q1 * q3 - q0 * q2)));
+        int h = atan2Degrees(q15(q1 * q2 + q0 * q3), q15(0.5f - q2 * q2 - q3 * q3));
+        heading = h < 0 ? h + 360 : h;
+    }
+
+    bool sample(float dt) {
+        float a[3], m[3];
+        read(a, m);
+        if (!normalize(a) || !normalize(m))
+            return false;
+        step(a, m, dt);
+        return true;
+    }
+
+    void run() {
+        // converge on the first reading instead of swinging in from the identity
+        float a[3], m[3];
+        read(a, m);
+        if (normalize(a) && normalize(m))
+            for (int i = 0; i < ORIENTATION_WARMUP_STEPS; ++i)
+                step(a, m, 0.05f);
+        updateAngles();
+
+        lastUpdate = system_timer_current_time();
+        while (running) {
+            fiber_sleep(period);
+            uint32_t now = system_timer_current_time();
+            float dt = (now - lastUpdate) / 1000.0f;
+            lastUpdate = now;
+            if (sample(dt))
+                updateAngles();
+        }
+        fiberRunning = false;
+    }
+};
+
+static OrientationFusion *fusion;
+
+static void orientationFiber(void *) {
+    fusion->run();
+}
+
+/**
+ * Fuses the accelerometer and the compass in the background at a fixed rate, to provide a
+ * steady orientation and a tilt-compensated heading. The compass may ask to be calibrated.
+ * @param rate updates per second, eg: 50
+ * @param responsiveness how fast the orientation follows the sensors, from 1 (slow) to 100, eg: 20
+ */
+//% parts="accelerometer compass" advanced=true responsiveness.defl=20
+void startOrientationFusion(int rate, int responsiveness = 20) {
+    loadCompassCalibration();
+    if (!fusion)
+        fusion = new OrientationFusion();
+    fusion->period = max(1, 1000 / max(1, min(rate, 200)));
+    fusion->twoKp = max(1, min(responsiveness, 100)) / 10.0f;
+    fusion->running = true;
+    if (!fusion->fiberRunning) {
+        fusion->fiberRunning = true;
+        create_fiber(orientationFiber, NULL);
+    }
+}
+
+/**
+ * Stops the background orientation fusion.
+ */
+//% parts="accelerometer compass" advanced=true
+void stopOrientationFusion() {
+    if (fusion)
+        fusion->running = false;
+}
+
+/**
+ * Gets the tilt-compensated compass heading in degrees, from the orientation fusion.
+ */
+//% parts="accelerometer compass" advanced=true
+int fusedHeading() {
+    return fusion ? fusion->heading : 0;
+}
+
+/**
+ * Gets the pitch in degrees, from the orientation fusion.
+ */
+//% parts="accelerometer compass" advanced=true
+int fusedPitch() {
+    return fusion ? fusion->pitch : 0;
+}
+
+/**
+ * Gets the roll in degrees, from the orientation fusion.
+ */
+//% parts="accelerometer compass" advanced=true
+int fusedRoll() {
+    return fusion ? fusion->roll : 0;
+}
+
+/**
+ * Gets a component of the orientation quaternion from the orientation fusion.
+ * @param index 0 for w, 1 for x, 2 for y, 3 for z
+ */
+//% parts="accelerometer compass" advanced=true
+TNumber orientationQuaternion(int index) {
+    if (!fusion)
+        return fromDouble(index == 0 ? 1 : 0);
+    float q[4] = {fusion->q0, fusion->q1, fusion->q2, fusion->q3};
+    return fromDouble(index >= 0 && index < 4 ? q[index] : 0);
+}
+
+} // namespace input
@@ -65,6 +65,91 @@ static inline int max_(int a, int b) {
 
 void initMicrobitGC();
 
+#if MICROBIT_CODAL
+#define SystemTickComponentBase codal::CodalComponent
+#else
+#define SystemTickComponentBase MicroBitComponent
+#endif
+
+// A component whose tick() is called from the system timer interrupt on both V1 and V2.
+class SystemTickComponent : public SystemTickComponentBase {
+  public:
+    SystemTickComponent();
+    virtual void tick() = 0;
+#if MICROBIT_CODAL
+    virtual void periodicCallback() override { tick(); }
+#else
+    virtual void systemTick() { tick(); }
+#endif
+};
+
+// A ring of GC-pinned buffers that a sensor fills one sample at a time, possibly from an
+// interrupt, and that the program reads one full block at a time (blockring.cpp). A block
+// handed to the program is swapped for a fresh one, so it is never written again; when every
+// block is full, new samples are dropped and counted as overruns.
+class BlockRing {
+  public:
+    Buffer *blocks;
+    int numBlocks;
+    int sampleSize;
+    int samplesPerBlock;
+    int writeBlock;
+    int writeSample;
+    int readBlock;
+    volatile int pending;
+    volatile int overruns;
+    volatile bool running;
+    uint16_t eventId;
+    uint16_t eventValue;
+
+    BlockRing(int numBlocks, int eventId, int eventValue);
+    // allocates the blocks and starts taking samples; must be called from a fiber
+    void start(int sampleSize, int samplesPerBlock);
+    void stop() { running = false; }
+    // copies one sample into the ring, raising the event when it fills a block
+    void write(const void *sample);
+    // the oldest full block, or NULL; must be called from a fiber
+    Buffer read();
+};
+
+// Integer vector kernels (vecmath.cpp).
+// Vectors are int16 x, y, z triplets; unit vectors are in Q15.
+uint32_t isqrt(uint32_t v);
+int magnitude3(int x, int y, int z);
+int dot3(const int16_t *a, const int16_t *b);
+void normalize3Q15(const int16_t *v, int16_t *out);
+void magnitudes3(const int16_t *xyz, int16_t *out, int n);
+void dots3(const int16_t *a, const int16_t *b, int32_t *out, int n);
+void normalizes3Q15(const int16_t *xyz, int16_t *out, int n);
+// Angles in whole degrees, rounded; asinDegrees takes a Q15 sine.
+int atan2Degrees(int y, int x);
+int asinDegrees(int sQ15);
+
+// Sensor readings behind input.setSensorCacheTime (sensorhub.cpp); axis 3 is the strength.
+int sensorAcceleration(int axis);
+int sensorRotation(int kind);
+int sensorMagneticForce(int axis);
+int sensorCompassHeading();
+int sensorTemperature();
+
+// Stops the background animation of led.playAnimation (ledanimation.cpp), if one is playing.
+void stopLedAnimation();
+// Called before any write to the display (led.cpp): stops the background animation and drops
+// the extra bits of the dithered greyscale mode, for the pixel at x, y or the whole screen.
+void beginDisplayWrite(int x = -1, int y = -1);
+// Reads the light level, going back to dithered greyscale afterwards if it was on (led.cpp).
+int readLightLevelKeepingMode();
+
+// Restores the compass calibration saved in flash, once, on the first use of the compass
+// (compasscalibration.cpp).
+void loadCompassCalibration();
+
+// The free flash after the program holds either the flash log or flash audio recordings, not
+// both; the first one to claim it keeps it until reset (codal.cpp).
+#define FREE_FLASH_LOG 1
+#define FREE_FLASH_AUDIO 2
+bool claimFreeFlash(int user);
+
 } // namespace pxt
 
 using namespace pxt;
@@ -0,0 +1,246 @@
+#include "pxt.h"
+
+enum class SampleFormat {
+    //% block="8 bit"
+    Int8 = 1,
+    //% block="16 bit"
+    Int16 = 2,
+};
+
+#ifndef SAMPLE_PLAYER_VOICES
+#define SAMPLE_PLAYER_VOICES 4
+#endif
+
+#ifndef SAMPLE_PLAYER_RATE
+#define SAMPLE_PLAYER_RATE 22050
+#endif
+
+#define SAMPLE_PLAYER_BLOCK 256
+
+namespace music {
+
+#if MICROBIT_CODAL
+/**
+ * A single mixer channel that mixes a few PCM voices straight out of their Buffers, so
+ * samples compiled into the program are played from flash without being copied to RAM.
+ * Voices are resampled with linear interpolation using a 16.16 fixed point step.
+ * The audio interrupt only reads the voices; Buffers are pinned and released from fibers.
+ */
+class SamplePlayer : public DataSource {
+  public:
+    struct Voice {
+        Buffer sample;
+        uint32_t index;
+        uint32_t frac; // 16 bit fraction of a sample
+        uint32_t step; // 16.16 fixed point
+        uint32_t length;
+        uint32_t serial;
+        int volume;
+        uint8_t format;
+        bool loop;
+        volatile bool playing;
+    };
+
+    Voice voices[SAMPLE_PLAYER_VOICES];
+    DataSink *output;
+    MixerChannel *channel;
+    volatile bool pulling;
+    uint32_t started;
+
+    SamplePlayer() : output(NULL), channel(NULL), pulling(false), started(0) {
+        memset(voices, 0, sizeof(voices));
+        MicroBitAudio::requestActivation();
+        channel = uBit.audio.mixer.addChannel(*this, SAMPLE_PLAYER_RATE);
+        channel->setVolume(75.0);
+        uBit.audio.setSpeakerEnabled(true);
+    }
+
+    static int read(const Voice &v, uint32_t i) {
+        if (v.format == (int)SampleFormat::Int16)
+            return ((const int16_t *)v.sample->data)[i];
+        return ((const int8_t *)v.sample->data)[i] << 8;
+    }
+
+    bool anyPlaying() {
+        for (int i = 0; i < SAMPLE_PLAYER_VOICES; ++i)
+            if (voices[i].playing)
+                return true;
+        return false;
+    }
+
+    virtual ManagedBuffer pull() override {
+        if (!anyPlaying()) {
+            pulling = false;
+            return ManagedBuffer();
+        }
+
+        int32_t mix[SAMPLE_PLAYER_BLOCK];
+        memset(mix, 0, sizeof(mix));
+        for (int k = 0; k < SAMPLE_PLAYER_VOICES; ++k) {
+            Voice &v = voices[k];
+            if (!v.playing)
+                continue;
+            for (int i = 0; i < SAMPLE_PLAYER_BLOCK; ++i) {
+                if (v.index >= v.length) {
+                    if (!v.loop) {
+                        v.playing = false;
+                        break;
+                    }
+                    v.index %= v.length;
+                }
+                uint32_t n = v.index;
+                int a = read(v, n);
+                int b = n + 1 < v.length ? read(v, n + 1) : v.loop ? read(v, 0) : a;
+                mix[i] += ((a + (((b - a) * (int)(v.frac >> 1)) >> 15)) * v.volume) >> 8;
+                v.frac += v.step;
+                v.index += v.frac >> 16;
+                v.frac &= 0xffff;
+            }
+        }
+
+        ManagedBuffer out(SAMPLE_PLAYER_BLOCK * sizeof(int16_t));
+        int16_t *dst = (int16_t *)out.getBytes();
+        for (int i = 0; i < SAMPLE_PLAYER_BLOCK; ++i)
+            dst[i] = max(-32768, min(32767, (int)mix[i]));
+
+        // always hand over the block, and only ask for another one while a voice is left
+        if (anyPlaying())
+            output->pullRequest();
+        else
+            pulling = false;
+        return out;
+    }
+
+    virtual void connect(DataSink &sink) override { output = &sink; }
+    virtual bool isConnected() override { return output != NULL; }
+    virtual void disconnect() override { output = NULL; }
+    virtual int getFormat() override { return DATASTREAM_FORMAT_16BIT_SIGNED; }
+    virtual float getSampleRate() override { return SAMPLE_PLAYER_RATE; }
+
+    // must be called from a fiber
+    void release(Voice &v) {
+        v.playing = false;
+        if (v.sample) {
+            unregisterGCObj(v.sample);
+            v.sample = NULL;
+        }
+    }
+
+    int allocVoice() {
+        // take a free voice, or steal the one started longest ago
+        int best = 0;
+        uint32_t bestAge = 0;
+        for (int i = 0; i < SAMPLE_PLAYER_VOICES; ++i) {
+            if (!voices[i].playing)
+                return i;
+            uint32_t age = started - voices[i].serial;
+            if (age >= bestAge) {
+                bestAge = age;
+                best = i;
+            }
+        }
+        return best;
+    }
+
+    int play(Buffer sample, int sampleRate, SampleFormat format, bool loop, int volume) {
+        int bytesPerSample = format == SampleFormat::Int16 ? 2 : 1;
+        uint32_t length = sample->length / bytesPerSample;
+        if (length == 0 || sampleRate <= 0)
+            return -1;
+
+        int k = allocVoice();
+        Voice &v = voices[k];
+        release(v);
+
+        registerGCObj(sample);
+        v.sample = sample;
+        v.format = (uint8_t)format;
+        v.loop = loop;
+        v.volume = max(0, min(255, volume)) + 1;
+        v.index = 0;
+        v.frac = 0;
+        v.length = length;
+        v.step = (uint32_t)(((uint64_t)sampleRate << 16) / SAMPLE_PLAYER_RATE);
+        v.serial = ++started;
+        v.playing = true;
+
+        __disable_irq();
+        bool wasPulling = pulling;
+        pulling = true;
+        __enable_irq();
+        if (!wasPulling && output)
+            output->pullRequest();
+        return k;
+    }
+
+    void stop(int k) {
+        if (k >= 0 && k < SAMPLE_PLAYER_VOICES)
+            release(voices[k]);
+    }
+};
+
+static SamplePlayer *samplePlayer;
+#endif
+
+/**
+ * Plays raw PCM samples from a buffer in the background, mixed with the other sounds.
+ * The buffer is read in place, so a hex literal is played straight from flash.
+ * Up to 4 samples play at once; starting another one replaces the oldest.
+ * @param sample signed 8-bit or 16-bit little endian samples
+ * @param sampleRate samples per second the buffer was recorded at, eg: 8000
+ * @param format the size of each sample
+ * @param loop whether to start over at the end of the buffer
+ * @param volume the volume 0...255, eg: 255
+ * @returns the voice playing the sample, or -1 if nothing is played
+ */
+//% parts="speaker" advanced=true
+int playSample(Buffer sample, int sampleRate, SampleFormat format = SampleFormat::Int8,
+               bool loop = false, int volume = 255) {
+#if MICROBIT_CODAL
+    if (!sample)
+        return -1;
+    if (!samplePlayer)
+        samplePlayer = new SamplePlayer();
+    return samplePlayer->play(sample, sampleRate, format, loop, volume);
+#else
+    target_panic(PANIC_VARIANT_NOT_SUPPORTED);
+    return -1;
+#endif
+}
+
+/**
+ * Stops a sample started with ``playSample``.
+ * @param voice the voice returned by ``playSample``, or -1 to stop all samples
+ */
+//% parts="speaker" advanced=true
+void stopSample(int voice) {
+#if MICROBIT_CODAL
+    if (!samplePlayer)
+        return;
+    if (voice < 0) {
+        for (int i = 0; i < SAMPLE_PLAYER_VOICES; ++i)
+            samplePlayer->stop(i);
+    } else {
+        samplePlayer->stop(voice);
+    }
+#endif
+}
+
+/**
+ * Tells whether a sample started with ``playSample`` is still playing.
+ * @param voice the voice returned by ``playSample``, or -1 for any sample
+ */
+//% parts="speaker" advanced=true
+bool isSamplePlaying(int voice) {
+#if MICROBIT_CODAL
+    if (!samplePlayer)
+        return false;
+    if (voice < 0)
+        return samplePlayer->anyPlaying();
+    return voice < SAMPLE_PLAYER_VOICES && samplePlayer->voices[voice].playing;
+#else
+    return false;
+#endif
+}
+
+} // namespace music
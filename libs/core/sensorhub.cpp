@@ -0,0 +1,191 @@
+#include "pxt.h"
+
+namespace pxt {
+
+/**
+ * Caches the motion sensors and the thermometer for a configurable time, so that the input
+ * functions called repeatedly within one iteration of a loop do not go back to the drivers.
+ * A refresh reads each motion sensor with a single sample request instead of one per axis,
+ * and reads the compass along with the accelerometer once the program has used it.
+ * Pitch, roll and heading are only derived when asked for.
+ */
+class SensorHub {
+  public:
+    uint32_t ttl;
+    uint32_t motionStamp;
+    uint32_t temperatureStamp;
+    bool motionValid, compassInUse, compassValid, rotationValid, headingValid, temperatureValid;
+    int acc[4];
+    int mag[4];
+    int pitch, roll, heading, temperature;
+    uint32_t hits, misses;
+
+    SensorHub() { memset(this, 0, sizeof(*this)); }
+
+    bool fresh(bool valid, uint32_t stamp) {
+        if (valid && system_timer_current_time() - stamp < ttl) {
+            hits++;
+            return true;
+        }
+        misses++;
+        return false;
+    }
+
+    void readCompass() {
+#if MICROBIT_CODAL
+        Sample3D s = uBit.compass.getSample();
+        mag[0] = s.x, mag[1] = s.y, mag[2] = s.z;
+#else
+        mag[0] = uBit.compass.getX(), mag[1] = uBit.compass.getY(), mag[2] = uBit.compass.getZ();
+#endif
+        mag[3] = uBit.compass.getFieldStrength();
+        compassValid = true;
+        headingValid = false;
+    }
+
+    void refreshMotion() {
+#if MICROBIT_CODAL
+        Sample3D s = uBit.accelerometer.getSample();
+        acc[0] = s.x, acc[1] = s.y, acc[2] = s.z;
+#else
+        acc[0] = uBit.accelerometer.getX();
+        acc[1] = uBit.accelerometer.getY();
+        acc[2] = uBit.accelerometer.getZ();
+#endif
+        acc[3] = magnitude3(acc[0], acc[1], acc[2]);
+        rotationValid = false;
+        compassValid = false;
+        if (compassInUse)
+            readCompass();
+        motionStamp = system_timer_current_time();
+        motionValid = true;
+    }
+
+    void motion() {
+        if (!fresh(motionValid, motionStamp))
+            refreshMotion();
+    }
+
+    void compass() {
+        compassInUse = true;
+        motion();
+        if (!compassValid)
+            readCompass();
+    }
+};
+
+static SensorHub *hub;
+
+static SensorHub *activeHub() {
+    return hub && hub->ttl ? hub : NULL;
+}
+
+int sensorAcceleration(int axis) {
+    SensorHub *h = activeHub();
+    if (!h) {
+        switch (axis) {
+        case 0: return uBit.accelerometer.getX();
+        case 1: return uBit.accelerometer.getY();
+        case 2: return uBit.accelerometer.getZ();
+        }
+#if MICROBIT_CODAL
+        Sample3D s = uBit.accelerometer.getSample();
+        return magnitude3(s.x, s.y, s.z);
+#else
+        return magnitude3(uBit.accelerometer.getX(), uBit.accelerometer.getY(),
+                          uBit.accelerometer.getZ());
+#endif
+    }
+    h->motion();
+    return h->acc[axis];
+}
+
+int sensorRotation(int kind) {
+    SensorHub *h = activeHub();
+    if (!h)
+        return kind == 0 ? uBit.accelerometer.getPitch() : uBit.accelerometer.getRoll();
+    h->motion();
+    if (!h->rotationValid) {
+        // the driver derives these from the sample it has just read
+        h->pitch = uBit.accelerometer.getPitch();
+        h->roll = uBit.accelerometer.getRoll();
+        h->rotationValid = true;
+    }
+    return kind == 0 ? h->pitch : h->roll;
+}
+
+int sensorMagneticForce(int axis) {
+    loadCompassCalibration();
+    SensorHub *h = activeHub();
+    if (!h) {
+        switch (axis) {
+        case 0: return uBit.compass.getX();
+        case 1: return uBit.compass.getY();
+        case 2: return uBit.compass.getZ();
+        }
+        return uBit.compass.getFieldStrength();
+    }
+    h->compass();
+    return h->mag[axis];
+}
+
+int sensorCompassHeading() {
+    loadCompassCalibration();
+    SensorHub *h = activeHub();
+    if (!h)
+        return uBit.compass.heading();
+    h->compass();
+    if (!h->headingValid) {
+        h->heading = uBit.compass.heading();
+        h->headingValid = true;
+    }
+    return h->heading;
+}
+
+int sensorTemperature() {
+    SensorHub *h = activeHub();
+    if (!h)
+        return uBit.thermometer.getTemperature();
+    if (!h->fresh(h->temperatureValid, h->temperatureStamp)) {
+        h->temperature = uBit.thermometer.getTemperature();
+        h->temperatureStamp = system_timer_current_time();
+        h->temperatureValid = true;
+    }
+    return h->temperature;
+}
+
+} // namespace pxt
+
+namespace input {
+
+/**
+ * Keeps sensor readings for some time, so that reading the accelerometer, compass or
+ * temperature again within that time does not access the sensors. Use 0 to always read the
+ * sensors.
+ * @param ms how long readings are kept in milliseconds, eg: 20
+ */
+//% advanced=true
+void setSensorCacheTime(int ms) {
+    if (!hub)
+        hub = new SensorHub();
+    hub->ttl = max(0, ms);
+    hub->motionValid = hub->temperatureValid = false;
+}
+
+/**
+ * Gets the number of sensor reads answered from the cache.
+ */
+//% advanced=true
+int sensorCacheHits() {
+    return hub ? hub->hits : 0;
+}
+
+/**
+ * Gets the number of sensor reads that had to access the sensors while the cache was on.
+ */
+//% advanced=true
+int sensorCacheMisses() {
+    return hub ? hub->misses : 0;
+}
+
+} // namespace input
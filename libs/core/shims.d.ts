@@ -116,6 +116,50 @@ declare interface Image {
     //% parts="ledmatrix" shim=ImageMethods::pixel
     pixel(x: int32, y: int32): boolean;
 
+    /**
+     * Draws another image on top of this one, clipping it to the bounds of this image.
+     * @param src image to draw
+     * @param x column of this image where the left edge of ``src`` goes
+     * @param y row of this image where the top edge of ``src`` goes
+     * @param mode how source pixels are combined with the existing pixels
+     */
+    //% parts="ledmatrix" mode.defl=0 shim=ImageMethods::drawImage
+    drawImage(src: Image, x: int32, y: int32, mode?: ImageDrawMode): void;
+
+    /**
+     * Copies a rectangle of another image (or of this image) into this image.
+     * @param src image to copy pixels from
+     * @param srcX left column of the rectangle in ``src``
+     * @param srcY top row of the rectangle in ``src``
+     * @param w width of the rectangle
+     * @param h height of the rectangle
+     * @param x destination column in this image
+     * @param y destination row in this image
+     */
+    //% parts="ledmatrix" shim=ImageMethods::copyRegion
+    copyRegion(src: Image, srcX: int32, srcY: int32, w: int32, h: int32, x: int32, y: int32): void;
+
+    /**
+     * Shifts the pixels of the image, turning off the pixels that are shifted in.
+     * @param dx columns to shift right, negative to shift left
+     * @param dy rows to shift down, negative to shift up
+     */
+    //% parts="ledmatrix" shim=ImageMethods::shift
+    shift(dx: int32, dy: int32): void;
+
+    /**
+     * Inverts the brightness of every pixel.
+     */
+    //% parts="ledmatrix" shim=ImageMethods::invert
+    invert(): void;
+
+    /**
+     * Sets every pixel to the given brightness.
+     * @param value brightness from 0 (off) to 255 (bright)
+     */
+    //% parts="ledmatrix" shim=ImageMethods::fill
+    fill(value: int32): void;
+
     /**
      * Show a particular frame of the image strip.
      * @param frame image frame to show
@@ -295,6 +339,33 @@ declare namespace input {
     //% parts="ledmatrix" shim=input::lightLevel
     function lightLevel(): int32;
 
+    /**
+     * Samples the light level in the background and keeps a smoothed value, so that
+     * ``light level`` returns immediately. Use a period of 0 to stop sampling.
+     * Sampling pauses while the screen shows greyscale, since measuring light turns it black and white.
+     * @param period time between two samples in milliseconds, eg: 100
+     * @param smoothing how much of the previous value is kept on each sample, from 0 (none) to 99 percent, eg: 80
+     */
+    //% parts="ledmatrix" advanced=true smoothing.defl=80 shim=input::setLightLevelSampling
+    function setLightLevelSampling(period: int32, smoothing?: int32): void;
+
+    /**
+     * Runs code when the smoothed light level crosses the dark or bright threshold.
+     * Starts background sampling if needed.
+     * @param condition the condition to detect
+     * @param handler code to run
+     */
+    //% parts="ledmatrix" advanced=true shim=input::onLightCondition
+    function onLightCondition(condition: LightCondition, handler: () => void): void;
+
+    /**
+     * Sets the light level below which it is dark, or above which it is bright.
+     * @param condition the threshold to change
+     * @param value light level from 0 (dark) to 255 (bright)
+     */
+    //% parts="ledmatrix" advanced=true shim=input::setLightThreshold
+    function setLightThreshold(condition: LightCondition, value: int32): void;
+
     /**
      * Get the current compass heading in degrees.
      */
@@ -351,6 +422,170 @@ declare namespace input {
     //% advanced=true shim=input::setAccelerometerRange
     function setAccelerometerRange(range: AcceleratorRange): void;
 }
+declare namespace input {
+
+    /**
+     * Streams accelerometer samples in the background, in blocks of packed signed 16-bit
+     * x, y, z values (milli-g). The rate is rounded to one the accelerometer supports.
+     * @param sampleRate samples per second, eg: 100
+     * @param samplesPerBlock number of samples in each block, eg: 32
+     */
+    //% parts="accelerometer" advanced=true shim=input::startAccelerationStream
+    function startAccelerationStream(sampleRate: int32, samplesPerBlock: int32): void;
+
+    /**
+     * Stops the accelerometer stream.
+     */
+    //% parts="accelerometer" advanced=true shim=input::stopAccelerationStream
+    function stopAccelerationStream(): void;
+
+    /**
+     * Takes the oldest full block of samples from the accelerometer stream.
+     * @returns null if no block is available
+     */
+    //% parts="accelerometer" advanced=true shim=input::readAccelerationBlock
+    function readAccelerationBlock(): Buffer;
+
+    /**
+     * Runs code each time a block of accelerometer samples is ready.
+     * @param handler code to run, typically calling ``readAccelerationBlock``
+     */
+    //% parts="accelerometer" advanced=true shim=input::onAccelerationBlock
+    function onAccelerationBlock(handler: () => void): void;
+
+    /**
+     * Gets the number of samples dropped because no block was free.
+     */
+    //% parts="accelerometer" advanced=true shim=input::accelerationStreamOverruns
+    function accelerationStreamOverruns(): int32;
+}
+declare namespace input {
+
+    /**
+     * Computes the strength of each sample in a buffer of packed signed 16-bit x, y, z values,
+     * such as a block from the accelerometer stream.
+     * @param samples packed x, y, z samples
+     * @returns a buffer of signed 16-bit strengths, one per sample
+     */
+    //% advanced=true shim=input::accelerationMagnitudes
+    function accelerationMagnitudes(samples: Buffer): Buffer;
+
+    /**
+     * Scales each sample in a buffer of packed signed 16-bit x, y, z values to unit length,
+     * with 32767 standing for 1.
+     * @param samples packed x, y, z samples
+     * @returns a buffer of packed signed 16-bit x, y, z directions
+     */
+    //% advanced=true shim=input::normalizeAccelerations
+    function normalizeAccelerations(samples: Buffer): Buffer;
+}
+declare namespace input {
+
+    /**
+     * Fuses the accelerometer and the compass in the background at a fixed rate, to provide a
+     * steady orientation and a tilt-compensated heading. The compass may ask to be calibrated.
+     * @param rate updates per second, eg: 50
+     * @param responsiveness how fast the orientation follows the sensors, from 1 (slow) to 100, eg: 20
+     */
+    //% parts="accelerometer compass" advanced=true responsiveness.defl=20 shim=input::startOrientationFusion
+    function startOrientationFusion(rate: int32, responsiveness?: int32): void;
+
+    /**
+     * Stops the background orientation fusion.
+     */
+    //% parts="accelerometer compass" advanced=true shim=input::stopOrientationFusion
+    function stopOrientationFusion(): void;
+
+    /**
+     * Gets the tilt-compensated compass heading in degrees, from the orientation fusion.
+     */
+    //% parts="accelerometer compass" advanced=true shim=input::fusedHeading
+    function fusedHeading(): int32;
+
+    /**
+     * Gets the pitch in degrees, from the orientation fusion.
+     */
+    //% parts="accelerometer compass" advanced=true shim=input::fusedPitch
+    function fusedPitch(): int32;
+
+    /**
+     * Gets the roll in degrees, from the orientation fusion.
+     */
+    //% parts="accelerometer compass" advanced=true shim=input::fusedRoll
+    function fusedRoll(): int32;
+
+    /**
+     * Gets a component of the orientation quaternion from the orientation fusion.
+     * @param index 0 for w, 1 for x, 2 for y, 3 for z
+     */
+    //% parts="accelerometer compass" advanced=true shim=input::orientationQuaternion
+    function orientationQuaternion(index: int32): number;
+}
+declare namespace input {
+
+    /**
+     * Forgets the compass calibration saved in flash, so that the compass is calibrated again
+     * after the next reset.
+     */
+    //% parts="compass" advanced=true shim=input::clearCompassCalibration
+    function clearCompassCalibration(): void;
+}
+declare namespace input {
+
+    /**
+     * Keeps sensor readings for some time, so that reading the accelerometer, compass or
+     * temperature again within that time does not access the sensors. Use 0 to always read the
+     * sensors.
+     * @param ms how long readings are kept in milliseconds, eg: 20
+     */
+    //% advanced=true shim=input::setSensorCacheTime
+    function setSensorCacheTime(ms: int32): void;
+
+    /**
+     * Gets the number of sensor reads answered from the cache.
+     */
+    //% advanced=true shim=input::sensorCacheHits
+    function sensorCacheHits(): int32;
+
+    /**
+     * Gets the number of sensor reads that had to access the sensors while the cache was on.
+     */
+    //% advanced=true shim=input::sensorCacheMisses
+    function sensorCacheMisses(): int32;
+}
+declare namespace input {
+
+    /**
+     * Records a custom gesture from the accelerometer, replacing any previous recording with the
+     * same number. Blocks while recording; perform the gesture once during that time.
+     * @param gesture number identifying the gesture, from 1, eg: 1
+     * @param duration how long to record in milliseconds, up to 1280, eg: 800
+     */
+    //% parts="accelerometer" advanced=true async shim=input::recordCustomGesture
+    function recordCustomGesture(gesture: int32, duration: int32): void;
+
+    /**
+     * Forgets a recorded custom gesture.
+     * @param gesture number identifying the gesture, eg: 1
+     */
+    //% parts="accelerometer" advanced=true shim=input::clearCustomGesture
+    function clearCustomGesture(gesture: int32): void;
+
+    /**
+     * Sets how different a movement may be from a recorded gesture and still match it.
+     * @param tolerance average difference allowed per sample, in units of 32mg per axis, eg: 12
+     */
+    //% parts="accelerometer" advanced=true shim=input::setCustomGestureTolerance
+    function setCustomGestureTolerance(tolerance: int32): void;
+
+    /**
+     * Runs code when a recorded custom gesture is recognized.
+     * @param gesture number identifying the gesture, eg: 1
+     * @param body code to run
+     */
+    //% parts="accelerometer" advanced=true shim=input::onCustomGesture
+    function onCustomGesture(gesture: int32, body: () => void): void;
+}
 
 
 
@@ -556,6 +791,15 @@ declare namespace led {
     //% advanced=true shim=led::plotBrightness
     function plotBrightness(x: int32, y: int32, brightness: int32): void;
 
+    /**
+     * Sets the brightness of every LED at once from a buffer of 25 bytes, row by row.
+     * The frame is swapped in between two refreshes so the screen never shows a partial update.
+     * @param frame brightness of each LED from 0 (off) to 255 (bright), row by row
+     */
+    //% parts="ledmatrix"
+    //% advanced=true shim=led::setFrame
+    function setFrame(frame: Buffer): void;
+
     /**
      * Turn off the specified LED using x, y coordinates (x is horizontal, y is vertical). (0,0) is upper left.
      * @param x the horizontal coordinate of the LED
@@ -625,6 +869,32 @@ declare namespace led {
     //% weight=1 parts="ledmatrix" advanced=true shim=led::displayMode
     function displayMode(): DisplayMode;
 
+    /**
+     * Sets the brightness of every LED from a buffer of 25 unsigned 16-bit little endian
+     * numbers, row by row, and switches to the dithered greyscale mode.
+     * @param frame brightness of each LED from 0 (off) to 65535 (bright), row by row
+     */
+    //% parts="ledmatrix" advanced=true shim=led::setFrameDithered
+    function setFrameDithered(frame: Buffer): void;
+
+    /**
+     * Configures the dithered greyscale mode. The dithering runs on the system tick, every few
+     * milliseconds, so the dimmest extra levels repeat only every 2^bits updates and may flicker.
+     * @param bits extra brightness bits below the 8 bits of the display, from 1 to 8; more bits
+     * give smoother dimming but a slower (possibly visible) modulation of the dimmest levels, eg: 4
+     * @param divider number of system ticks between two updates; higher values use less CPU, eg: 1
+     */
+    //% parts="ledmatrix" advanced=true shim=led::setDitherOptions
+    function setDitherOptions(bits: int32, divider: int32): void;
+
+    /**
+     * Gets the time the dithered greyscale mode spent in its last update, or in its longest one
+     * since the mode started, in microseconds. Updates run in the system tick interrupt.
+     * @param longest whether to return the longest update rather than the last one
+     */
+    //% parts="ledmatrix" advanced=true longest.defl=0 shim=led::ditherUpdateCost
+    function ditherUpdateCost(longest?: boolean): int32;
+
     /**
      * Turns on or off the display
      */
@@ -639,6 +909,40 @@ declare namespace led {
     //% parts="ledmatrix" shim=led::screenshot
     function screenshot(): Image;
 }
+declare namespace led {
+
+    /**
+     * Plays the frames of an image strip in the background, without blocking the calling code.
+     * Anything else drawn on the screen cancels it.
+     * @param frames image made of 5x5 frames side by side
+     * @param durations how long each frame is shown in milliseconds, as unsigned 16-bit little
+     * endian numbers; the last duration is used for the remaining frames
+     * @param loop whether to restart from the first frame after the last one
+     * @param ease whether to fade the brightness from each frame into the next one
+     */
+    //% parts="ledmatrix" advanced=true loop.defl=0 ease.defl=0 shim=led::playAnimation
+    function playAnimation(frames: Image, durations: Buffer, loop?: boolean, ease?: boolean): void;
+
+    /**
+     * Stops the background animation started with ``playAnimation``.
+     */
+    //% parts="ledmatrix" advanced=true shim=led::cancelAnimation
+    function cancelAnimation(): void;
+
+    /**
+     * Tells whether a background animation is playing.
+     */
+    //% parts="ledmatrix" advanced=true shim=led::isAnimationPlaying
+    function isAnimationPlaying(): boolean;
+
+    /**
+     * Runs code when the background animation completes, loops or is cancelled.
+     * @param event the animation event to listen for
+     * @param body code to run
+     */
+    //% parts="ledmatrix" advanced=true shim=led::onAnimationEvent
+    function onAnimationEvent(event: LedAnimationEvent, body: () => void): void;
+}
 declare namespace music {
 
     /**
@@ -697,6 +1001,105 @@ declare namespace music {
     //% weight=1 level.defl=0 shim=music::setSilenceLevel
     function setSilenceLevel(level?: int32): void;
 }
+declare namespace music {
+
+    /**
+     * Plays raw PCM samples from a buffer in the background, mixed with the other sounds.
+     * The buffer is read in place, so a hex literal is played straight from flash.
+     * Up to 4 samples play at once; starting another one replaces the oldest.
+     * @param sample signed 8-bit or 16-bit little endian samples
+     * @param sampleRate samples per second the buffer was recorded at, eg: 8000
+     * @param format the size of each sample
+     * @param loop whether to start over at the end of the buffer
+     * @param volume the volume 0...255, eg: 255
+     * @returns the voice playing the sample, or -1 if nothing is played
+     */
+    //% parts="speaker" advanced=true format.defl=1 loop.defl=0 volume.defl=255 shim=music::playSample
+    function playSample(sample: Buffer, sampleRate: int32, format?: SampleFormat, loop?: boolean, volume?: int32): int32;
+
+    /**
+     * Stops a sample started with ``playSample``.
+     * @param voice the voice returned by ``playSample``, or -1 to stop all samples
+     */
+    //% parts="speaker" advanced=true shim=music::stopSample
+    function stopSample(voice: int32): void;
+
+    /**
+     * Tells whether a sample started with ``playSample`` is still playing.
+     * @param voice the voice returned by ``playSample``, or -1 for any sample
+     */
+    //% parts="speaker" advanced=true shim=music::isSamplePlaying
+    function isSamplePlaying(voice: int32): boolean;
+}
+declare namespace music {
+
+    /**
+     * Starts a note on the synthesizer, which plays several notes at once in the background.
+     * The note keeps sounding at the sustain level until ``synthNoteOff`` is called.
+     * @param frequency pitch of the note in Hz, eg: 440
+     * @param velocity how loud the note is 0...255, eg: 255
+     * @param waveform the shape of the sound wave
+     */
+    //% parts="speaker" advanced=true velocity.defl=255 waveform.defl=0 shim=music::synthNoteOn
+    function synthNoteOn(frequency: int32, velocity?: int32, waveform?: SynthWaveform): void;
+
+    /**
+     * Releases the synthesizer notes playing at a frequency.
+     * @param frequency pitch of the note in Hz, eg: 440
+     */
+    //% parts="speaker" advanced=true shim=music::synthNoteOff
+    function synthNoteOff(frequency: int32): void;
+
+    /**
+     * Releases all the synthesizer notes.
+     */
+    //% parts="speaker" advanced=true shim=music::synthAllNotesOff
+    function synthAllNotesOff(): void;
+
+    /**
+     * Sets the ADSR envelope of the synthesizer notes started from now on.
+     * @param attack time to rise to full volume in milliseconds, eg: 10
+     * @param decay time to fall to the sustain level in milliseconds, eg: 100
+     * @param sustain level held until the note is released 0...255, eg: 180
+     * @param release time to fade out once released in milliseconds, eg: 200
+     */
+    //% parts="speaker" advanced=true shim=music::setSynthEnvelope
+    function setSynthEnvelope(attack: int32, decay: int32, sustain: int32, release: int32): void;
+
+    /**
+     * Plays a track of notes on the synthesizer in the background. Notes are timed by the audio
+     * output itself, so several tracks stay in step whatever the program is doing.
+     * @param track which track to play on 0...3, eg: 0
+     * @param notes 6 bytes per note: frequency in Hz and duration in milliseconds as unsigned
+     * 16-bit little endian numbers, then the volume 0...255 and the ``SynthWaveform``; a frequency
+     * or volume of 0 is a rest
+     * @param loop whether to start over after the last note
+     */
+    //% parts="speaker" advanced=true loop.defl=0 shim=music::playTrack
+    function playTrack(track: int32, notes: Buffer, loop?: boolean): void;
+
+    /**
+     * Stops a track started with ``playTrack``.
+     * @param track the track to stop, or -1 to stop all tracks
+     */
+    //% parts="speaker" advanced=true shim=music::stopTrack
+    function stopTrack(track: int32): void;
+
+    /**
+     * Tells whether a track started with ``playTrack`` is still playing.
+     * @param track the track to check, or -1 for any track
+     */
+    //% parts="speaker" advanced=true shim=music::isTrackPlaying
+    function isTrackPlaying(track: int32): boolean;
+
+    /**
+     * Runs code when a track played without looping reaches its end.
+     * @param track the track to listen to 0...3, eg: 0
+     * @param handler code to run
+     */
+    //% parts="speaker" advanced=true shim=music::onTrackDone
+    function onTrackDone(track: int32, handler: () => void): void;
+}
 declare namespace pins {
 
     /**
@@ -1258,6 +1661,14 @@ declare namespace light {
     //% advanced=true shim=light::sendWS2812BufferWithBrightness
     function sendWS2812BufferWithBrightness(buf: Buffer, pin: int32, brightness: int32): void;
 
+    /**
+     * Sends a color buffer of RGB triplets to an APA102 or SK9822 strip over the SPI bus
+     * configured with ``pins.spiPins`` and ``pins.spiFrequency``.
+     * @param brightness global brightness from 0 (off) to 255, applied by the LEDs
+     **/
+    //% advanced=true shim=light::sendAPA102Buffer
+    function sendAPA102Buffer(buf: Buffer, brightness: int32): void;
+
     /**
      * Sets the light mode of a pin
      **/
@@ -0,0 +1,532 @@
+#include "pxt.h"
+
+enum class SynthWaveform {
+    //% block="sine"
+    Sine = 0,
+    //% block="sawtooth"
+    Sawtooth = 1,
+    //% block="triangle"
+    Triangle = 2,
+    //% block="square"
+    Square = 3,
+};
+
+#ifndef SYNTH_VOICES
+#define SYNTH_VOICES 6
+#endif
+
+#ifndef SYNTH_RATE
+#define SYNTH_RATE 22050
+#endif
+
+#ifndef SYNTH_QUEUE_SIZE
+#define SYNTH_QUEUE_SIZE 32
+#endif
+
+#ifndef SYNTH_TRACKS
+#define SYNTH_TRACKS 4
+#endif
+
+#define SYNTH_SEQUENCER_ID 9516
+// frequency (Hz) and duration (ms) as unsigned 16 bit little endian, then volume and waveform
+#define SYNTH_NOTE_SIZE 6
+
+#define SYNTH_BLOCK 256
+#define SYNTH_TABLE_BITS 8
+#define SYNTH_TABLE_SIZE (1 << SYNTH_TABLE_BITS)
+#define SYNTH_WAVEFORMS 4
+// envelope levels are 8.24 fixed point
+#define SYNTH_ENVELOPE_MAX (1 << 24)
+
+namespace music {
+
+#if MICROBIT_CODAL
+enum class SynthStage : uint8_t { Off, Attack, Decay, Sustain, Release };
+
+enum class SynthEventType : uint8_t { NoteOn, NoteOff, AllOff };
+
+struct SynthEvent {
+    SynthEventType type;
+    uint8_t waveform;
+    uint8_t velocity;
+    uint16_t frequency;
+};
+
+/**
+ * A polyphonic synthesizer mixed on its own mixer channel. Each voice reads one cycle of a
+ * waveform from a table with a 32 bit phase accumulator and is shaped by an ADSR envelope.
+ * Programs never touch the voices: notes are queued and picked up by the audio interrupt at
+ * the start of the next block, so a busy scheduler cannot make notes stutter.
+ * Tracks of notes are sequenced by the same interrupt, counting output samples, and blocks
+ * are split at note boundaries so each note starts on the exact sample it is due.
+ */
+class Synth : public DataSource {
+  public:
+    struct Voice {
+        uint32_t phase;
+        uint32_t step;
+        int32_t level;
+        int32_t releaseStep;
+        const int16_t *table;
+        uint32_t serial;
+        uint16_t frequency;
+        uint8_t velocity;
+        volatile SynthStage stage;
+    };
+
+    struct Track {
+        Buffer notes;
+        uint32_t next;      // offset of the next note in the buffer
+        uint32_t remaining; // samples left in the current note
+        Voice *voice;
+        uint32_t voiceSerial;
+        bool loop;
+        volatile bool playing;
+    };
+
+    Voice voices[SYNTH_VOICES];
+    Track tracks[SYNTH_TRACKS];
+    int16_t tables[SYNTH_WAVEFORMS][SYNTH_TABLE_SIZE];
+    SynthEvent queue[SYNTH_QUEUE_SIZE];
+    // the queue is written by fibers at the head and read by the interrupt at the tail
+    volatile uint32_t queueHead;
+    volatile uint32_t queueTail;
+    int32_t attackStep;
+    int32_t decayStep;
+    int32_t sustainLevel;
+    int32_t releaseSamples;
+    uint32_t serial;
+    DataSink *output;
+    MixerChannel *channel;
+    volatile bool pulling;
+
+    Synth()
+        : queueHead(0), queueTail(0), serial(0), output(NULL), channel(NULL), pulling(false) {
+        memset(voices, 0, sizeof(voices));
+        memset(tracks, 0, sizeof(tracks));
+        buildTables();
+        setEnvelope(10, 100, 180, 200);
+        MicroBitAudio::requestActivation();
+        channel = uBit.audio.mixer.addChannel(*this, SYNTH_RATE);
+        channel->setVolume(75.0);
+        uBit.audio.setSpeakerEnabled(true);
+    }
+
+    // All four waveforms have the same RMS level, so that switching waveform keeps the
+    // loudness. Full-scale sawtooth and triangle have the lowest, 32767 / sqrt(3) = 18918; the
+    // sine peaks at 18918 * sqrt(2) and the square sits at +/-18918.
+    void buildTables() {
+        int half = SYNTH_TABLE_SIZE / 2;
+        for (int i = 0; i < SYNTH_TABLE_SIZE; ++i) {
+            tables[(int)SynthWaveform::Sine][i] =
+                (int16_t)(26754 * sinf(i * (2 * 3.14159265f / SYNTH_TABLE_SIZE)));
+            tables[(int)SynthWaveform::Sawtooth][i] = -32767 + i * 65534 / (SYNTH_TABLE_SIZE - 1);
+            int t = i < half ? i : SYNTH_TABLE_SIZE - i;
+            tables[(int)SynthWaveform::Triangle][i] = -32767 + t * 65534 / half;
+            tables[(int)SynthWaveform::Square][i] = i < half ? 18918 : -18918;
+        }
+    }
+
+    static int32_t samples(int ms) { return max(1, ms * (SYNTH_RATE / 1000)); }
+
+    void setEnvelope(int attack, int decay, int sustain, int release) {
+        sustainLevel = max(0, min(255, sustain)) << 16;
+        attackStep = SYNTH_ENVELOPE_MAX / samples(max(0, attack));
+        decayStep = max(1, (SYNTH_ENVELOPE_MAX - sustainLevel) / samples(max(0, decay)));
+        releaseSamples = samples(max(0, release));
+    }
+
+    bool push(SynthEventType type, int frequency, int velocity, int waveform) {
+        uint32_t head = queueHead;
+        while (head - queueTail >= SYNTH_QUEUE_SIZE) {
+            if (!pulling)
+                return false;
+            fiber_sleep(1);
+        }
+        SynthEvent &e = queue[head % SYNTH_QUEUE_SIZE];
+        e.type = type;
+        e.frequency = max(0, min(0xffff, frequency));
+        e.velocity = max(0, min(255, velocity));
+        e.waveform = max(0, min(SYNTH_WAVEFORMS - 1, waveform));
+        queueHead = head + 1;
+        wake();
+        return true;
+    }
+
+    void wake() {
+        __disable_irq();
+        bool wasPulling = pulling;
+        pulling = true;
+        __enable_irq();
+        if (!wasPulling && output)
+            output->pullRequest();
+    }
+
+    Voice *allocVoice() {
+        // take a silent voice, or else the oldest releasing one, or else the oldest one
+        Voice *best = &voices[0];
+        int bestRank = -1;
+        for (int i = 0; i < SYNTH_VOICES; ++i) {
+            Voice *v = &voices[i];
+            if (v->stage == SynthStage::Off)
+                return v;
+            int rank = v->stage == SynthStage::Release ? 1 : 0;
+            if (rank > bestRank || (rank == bestRank && v->serial < best->serial)) {
+                best = v;
+                bestRank = rank;
+            }
+        }
+        return best;
+    }
+
+    Voice *noteOn(const SynthEvent &e) {
+        if (e.frequency == 0 || e.velocity == 0)
+            return NULL;
+        Voice *v = allocVoice();
+        // keep the phase of a stolen voice to avoid a click
+        v->step = (uint32_t)(((uint64_t)e.frequency << 32) / SYNTH_RATE);
+        v->table = tables[e.waveform];
+        v->frequency = e.frequency;
+        v->velocity = e.velocity;
+        v->serial = ++serial;
+        if (v->stage == SynthStage::Off)
+            v->level = 0;
+        v->stage = SynthStage::Attack;
+        return v;
+    }
+
+    void release(Voice *v) {
+        if (v->stage == SynthStage::Off || v->stage == SynthStage::Release)
+            return;
+        v->releaseStep = max(1, v->level / releaseSamples);
+        v->stage = SynthStage::Release;
+    }
+
+    void noteOff(const SynthEvent &e) {
+        for (int i = 0; i < SYNTH_VOICES; ++i)
+            if (voices[i].frequency == e.frequency)
+                release(&voices[i]);
+    }
+
+    void dispatch(const SynthEvent &e) {
+        switch (e.type) {
+        case SynthEventType::NoteOn:
+            noteOn(e);
+            break;
+        case SynthEventType::NoteOff:
+            noteOff(e);
+            break;
+        case SynthEventType::AllOff:
+            for (int i = 0; i < SYNTH_VOICES; ++i)
+                release(&voices[i]);
+            break;
+        }
+    }
+
+    void drainQueue() {
+        uint32_t tail = queueTail;
+        while (tail != queueHead) {
+            dispatch(queue[tail % SYNTH_QUEUE_SIZE]);
+            queueTail = ++tail;
+        }
+    }
+
+    void advanceEnvelope(Voice &v) {
+        switch (v.stage) {
+        case SynthStage::Attack:
+            v.level += attackStep;
+            if (v.level >= SYNTH_ENVELOPE_MAX) {
+                v.level = SYNTH_ENVELOPE_MAX;
+                v.stage = SynthStage::Decay;
+            }
+            break;
+        case SynthStage::Decay:
+            v.level -= decayStep;
+            if (v.level <= sustainLevel) {
+                v.level = sustainLevel;
+                v.stage = sustainLevel ? SynthStage::Sustain : SynthStage::Off;
+            }
+            break;
+        case SynthStage::Release:
+            v.level -= v.releaseStep;
+            if (v.level <= 0) {
+                v.level = 0;
+                v.stage = SynthStage::Off;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    void render(int32_t *mix, int n) {
+        for (int k = 0; k < SYNTH_VOICES; ++k) {
+            Voice &v = voices[k];
+            if (v.stage == SynthStage::Off)
+                continue;
+            for (int i = 0; i < n && v.stage != SynthStage::Off; ++i) {
+                uint32_t idx = v.phase >> (32 - SYNTH_TABLE_BITS);
+                int frac = (v.phase >> (17 - SYNTH_TABLE_BITS)) & 0x7fff;
+                int a = v.table[idx];
+                int b = v.table[(idx + 1) & (SYNTH_TABLE_SIZE - 1)];
+                int s = a + (((b - a) * frac) >> 15);
+                // 8.24 envelope down to 15 bits, and velocity halved to leave some headroom
+                mix[i] += (((s * (v.level >> 9)) >> 15) * v.velocity) >> 9;
+                v.phase += v.step;
+                advanceEnvelope(v);
+            }
+        }
+    }
+
+    void releaseTrackVoice(Track &t) {
+        // the voice may have been stolen by another note since
+        if (t.voice && t.voice->serial == t.voiceSerial)
+            release(t.voice);
+        t.voice = NULL;
+    }
+
+    void advanceTrack(Track &t, int index) {
+        releaseTrackVoice(t);
+        if (t.next + SYNTH_NOTE_SIZE > t.notes->length) {
+            if (!t.loop) {
+                t.playing = false;
+                MicroBitEvent(SYNTH_SEQUENCER_ID, index + 1);
+                return;
+            }
+            t.next = 0;
+        }
+
+        const uint8_t *p = t.notes->data + t.next;
+        t.next += SYNTH_NOTE_SIZE;
+        uint32_t ms = p[2] | (p[3] << 8);
+        // a zero length note would never let the track move on
+        t.remaining = max(1, (int)(ms * SYNTH_RATE / 1000));
+
+        SynthEvent e;
+        e.type = SynthEventType::NoteOn;
+        e.frequency = p[0] | (p[1] << 8);
+        e.velocity = p[4];
+        e.waveform = min(SYNTH_WAVEFORMS - 1, (int)p[5]);
+        t.voice = noteOn(e);
+        if (t.voice)
+            t.voiceSerial = t.voice->serial;
+    }
+
+    // renders n samples, stopping at each note boundary to move the tracks along
+    void sequence(int32_t *mix, int n) {
+        while (n > 0) {
+            int chunk = n;
+            for (int k = 0; k < SYNTH_TRACKS; ++k) {
+                Track &t = tracks[k];
+                if (t.playing && t.remaining == 0)
+                    advanceTrack(t, k);
+                if (t.playing)
+                    chunk = min(chunk, (int)t.remaining);
+            }
+            render(mix, chunk);
+            for (int k = 0; k < SYNTH_TRACKS; ++k)
+                if (tracks[k].playing)
+                    tracks[k].remaining -= chunk;
+            mix += chunk;
+            n -= chunk;
+        }
+    }
+
+    // must be called from a fiber
+    void playTrack(int k, Buffer notes, bool loop) {
+        stopTrack(k);
+        if (notes->length < SYNTH_NOTE_SIZE)
+            return;
+        Track &t = tracks[k];
+        registerGCObj(notes);
+        t.notes = notes;
+        t.next = 0;
+        t.remaining = 0;
+        t.voice = NULL;
+        t.loop = loop;
+        t.playing = true;
+        wake();
+    }
+
+    // must be called from a fiber
+    void stopTrack(int k) {
+        Track &t = tracks[k];
+        __disable_irq();
+        if (t.playing)
+            releaseTrackVoice(t);
+        t.playing = false;
+        __enable_irq();
+        if (t.notes) {
+            unregisterGCObj(t.notes);
+            t.notes = NULL;
+        }
+    }
+
+    bool active() {
+        if (queueTail != queueHead)
+            return true;
+        for (int i = 0; i < SYNTH_TRACKS; ++i)
+            if (tracks[i].playing)
+                return true;
+        for (int i = 0; i < SYNTH_VOICES; ++i)
+            if (voices[i].stage != SynthStage::Off)
+                return true;
+        return false;
+    }
+
+    virtual ManagedBuffer pull() override {
+        drainQueue();
+        if (!active()) {
+            pulling = false;
+            return ManagedBuffer();
+        }
+
+        int32_t mix[SYNTH_BLOCK];
+        memset(mix, 0, sizeof(mix));
+        sequence(mix, SYNTH_BLOCK);
+
+        ManagedBuffer out(SYNTH_BLOCK * sizeof(int16_t));
+        int16_t *dst = (int16_t *)out.getBytes();
+        for (int i = 0; i < SYNTH_BLOCK; ++i)
+            dst[i] = max(-32768, min(32767, (int)mix[i]));
+
+        if (active())
+            output->pullRequest();
+        else
+            pulling = false;
+        return out;
+    }
+
+    virtual void connect(DataSink &sink) override { output = &sink; }
+    virtual bool isConnected() override { return output != NULL; }
+    virtual void disconnect() override { output = NULL; }
+    virtual int getFormat() override { return DATASTREAM_FORMAT_16BIT_SIGNED; }
+    virtual float getSampleRate() override { return SYNTH_RATE; }
+};
+
+static Synth *synth;
+
+static Synth *getSynth() {
+    if (!synth)
+        synth = new Synth();
+    return synth;
+}
+#endif
+
+/**
+ * Starts a note on the synthesizer, which plays several notes at once in the background.
+ * The note keeps sounding at the sustain level until ``synthNoteOff`` is called.
+ * @param frequency pitch of the note in Hz, eg: 440
+ * @param velocity how loud the note is 0...255, eg: 255
+ * @param waveform the shape of the sound wave
+ */
+//% parts="speaker" advanced=true
+void synthNoteOn(int frequency, int velocity = 255, SynthWaveform waveform = SynthWaveform::Sine) {
+#if MICROBIT_CODAL
+    getSynth()->push(SynthEventType::NoteOn, frequency, velocity, (int)waveform);
+#else
+    target_panic(PANIC_VARIANT_NOT_SUPPORTED);
+#endif
+}
+
+/**
+ * Releases the synthesizer notes playing at a frequency.
+ * @param frequency pitch of the note in Hz, eg: 440
+ */
+//% parts="speaker" advanced=true
+void synthNoteOff(int frequency) {
+#if MICROBIT_CODAL
+    if (synth)
+        synth->push(SynthEventType::NoteOff, frequency, 0, 0);
+#endif
+}
+
+/**
+ * Releases all the synthesizer notes.
+ */
+//% parts="speaker" advanced=true
+void synthAllNotesOff() {
+#if MICROBIT_CODAL
+    if (synth)
+        synth->push(SynthEventType::AllOff, 0, 0, 0);
+#endif
+}
+
+/**
+ * Sets the ADSR envelope of the synthesizer notes started from now on.
+ * @param attack time to rise to full volume in milliseconds, eg: 10
+ * @param decay time to fall to the sustain level in milliseconds, eg: 100
+ * @param sustain level held until the note is released 0...255, eg: 180
+ * @param release time to fade out once released in milliseconds, eg: 200
+ */
+//% parts="speaker" advanced=true
+void setSynthEnvelope(int attack, int decay, int sustain, int release) {
+#if MICROBIT_CODAL
+    getSynth()->setEnvelope(attack, decay, sustain, release);
+#else
+    target_panic(PANIC_VARIANT_NOT_SUPPORTED);
+#endif
+}
+
+/**
+ * Plays a track of notes on the synthesizer in the background. Notes are timed by the audio
+ * output itself, so several tracks stay in step whatever the program is doing.
+ * @param track which track to play on 0...3, eg: 0
+ * @param notes 6 bytes per note: frequency in Hz and duration in milliseconds as unsigned
+ * 16-bit little endian numbers, then the volume 0...255 and the ``SynthWaveform``; a frequency
+ * or volume of 0 is a rest
+ * @param loop whether to start over after the last note
+ */
+//% parts="speaker" advanced=true
+void playTrack(int track, Buffer notes, bool loop = false) {
+#if MICROBIT_CODAL
+    if (!notes || track < 0 || track >= SYNTH_TRACKS)
+        return;
+    getSynth()->playTrack(track, notes, loop);
+#else
+    target_panic(PANIC_VARIANT_NOT_SUPPORTED);
+#endif
+}
+
+/**
+ * Stops a track started with ``playTrack``.
+ * @param track the track to stop, or -1 to stop all tracks
+ */
+//% parts="speaker" advanced=true
+void stopTrack(int track) {
+#if MICROBIT_CODAL
+    if (!synth)
+        return;
+    for (int k = 0; k < SYNTH_TRACKS; ++k)
+        if (track < 0 || track == k)
+            synth->stopTrack(k);
+#endif
+}
+
+/**
+ * Tells whether a track started with ``playTrack`` is still playing.
+ * @param track the track to check, or -1 for any track
+ */
+//% parts="speaker" advanced=true
+bool isTrackPlaying(int track) {
+#if MICROBIT_CODAL
+    if (!synth)
+        return false;
+    for (int k = 0; k < SYNTH_TRACKS; ++k)
+        if ((track < 0 || track == k) && synth->tracks[k].playing)
+            return true;
+#endif
+    return false;
+}
+
+/**
+ * Runs code when a track played without looping reaches its end.
+ * @param track the track to listen to 0...3, eg: 0
+ * @param handler code to run
+ */
+//% parts="speaker" advanced=true
+void onTrackDone(int track, Action handler) {
+    registerWithDal(SYNTH_SEQUENCER_ID, track + 1, handler);
+}
+
+} // namespace music
@@ -0,0 +1,133 @@
+#include "pxt.h"
+
+namespace pxt {
+
+// bit-by-bit square root, rounded down; no multiply or divide in the loop
+uint32_t isqrt(uint32_t v) {
+    uint32_t res = 0;
+    uint32_t bit = 1u << 30;
+    while (bit > v)
+        bit >>= 2;
+    while (bit) {
+        if (v >= res + bit) {
+            v -= res + bit;
+            res = (res >> 1) + bit;
+        } else {
+            res >>= 1;
+        }
+        bit >>= 2;
+    }
+    return res;
+}
+
+// the sum of squares of three int16 values always fits in 32 unsigned bits
+static inline uint32_t squared3(int x, int y, int z) {
+    return (uint32_t)(x * x) + (uint32_t)(y * y) + (uint32_t)(z * z);
+}
+
+static inline int16_t clampQ15(int32_t v) {
+    return v > 32767 ? 32767 : v < -32768 ? -32768 : v;
+}
+
+int magnitude3(int x, int y, int z) {
+    return isqrt(squared3(x, y, z));
+}
+
+int dot3(const int16_t *a, const int16_t *b) {
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+void normalize3Q15(const int16_t *v, int16_t *out) {
+    uint32_t n = isqrt(squared3(v[0], v[1], v[2]));
+    if (n == 0) {
+        out[0] = out[1] = out[2] = 0;
+        return;
+    }
+    // one divide per vector; v / n * 2^15 == v * (2^31 / n) >> 16
+    uint32_t inv = 0x80000000u / n;
+    for (int i = 0; i < 3; ++i)
+        out[i] = clampQ15((int32_t)(((int64_t)v[i] * inv) >> 16));
+}
+
+void magnitudes3(const int16_t *xyz, int16_t *out, int n) {
+    for (int i = 0; i < n; ++i, xyz += 3) {
+        uint32_t m = isqrt(squared3(xyz[0], xyz[1], xyz[2]));
+        out[i] = m > 32767 ? 32767 : m;
+    }
+}
+
+void dots3(const int16_t *a, const int16_t *b, int32_t *out, int n) {
+    for (int i = 0; i < n; ++i, a += 3, b += 3)
+        out[i] = dot3(a, b);
+}
+
+void normalizes3Q15(const int16_t *xyz, int16_t *out, int n) {
+    for (int i = 0; i < n; ++i, xyz += 3, out += 3)
+        normalize3Q15(xyz, out);
+}
+
+// atan(t) ~ 45t + t(1 - t)(14.02 + 3.80t) degrees on [0, 1], within 0.1 degree; the octant is
+// then unfolded from the signs and the larger of x and y, so only one divide is needed
+int atan2Degrees(int y, int x) {
+    uint32_t ax = x < 0 ? -x : x;
+    uint32_t ay = y < 0 ? -y : y;
+    if (ax == 0 && ay == 0)
+        return 0;
+    uint32_t lo = ax < ay ? ax : ay;
+    uint32_t hi = ax < ay ? ay : ax;
+    int64_t t = ((int64_t)lo << 15) / hi;
+    // hundredths of a degree
+    int64_t a = (4500 * t + ((t * (32768 - t)) >> 15) * (1402 + ((380 * t) >> 15))) >> 15;
+    if (ay > ax)
+        a = 9000 - a;
+    if (x < 0)
+        a = 18000 - a;
+    int deg = (int)((a + 50) / 100);
+    return y < 0 ? -deg : deg;
+}
+
+int asinDegrees(int sQ15) {
+    if (sQ15 > 32768)
+        sQ15 = 32768;
+    else if (sQ15 < -32768)
+        sQ15 = -32768;
+    return atan2Degrees(sQ15, isqrt((1u << 30) - (uint32_t)(sQ15 * sQ15)));
+}
+
+} // namespace pxt
+
+namespace input {
+
+/**
+ * Computes the strength of each sample in a buffer of packed signed 16-bit x, y, z values,
+ * such as a block from the accelerometer stream.
+ * @param samples packed x, y, z samples
+ * @returns a buffer of signed 16-bit strengths, one per sample
+ */
+//% advanced=true
+Buffer accelerationMagnitudes(Buffer samples) {
+    if (!samples)
+        return NULL;
+    int n = samples->length / 6;
+    Buffer res = mkBuffer(NULL, n * 2);
+    magnitudes3((const int16_t *)samples->data, (int16_t *)res->data, n);
+    return res;
+}
+
+/**
+ * Scales each sample in a buffer of packed signed 16-bit x, y, z values to unit length,
+ * with 32767 standing for 1.
+ * @param samples packed x, y, z samples
+ * @returns a buffer of packed signed 16-bit x, y, z directions
+ */
+//% advanced=true
+Buffer normalizeAccelerations(Buffer samples) {
+    if (!samples)
+        return NULL;
+    int n = samples->length / 6;
+    Buffer res = mkBuffer(NULL, n * 6);
+    normalizes3Q15((const int16_t *)samples->data, (int16_t *)res->data, n);
+    return res;
+}
+
+} // namespace input
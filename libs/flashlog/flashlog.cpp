@@ -26,6 +26,13 @@ enum class FlashLogTimeStampFormat
 //%
 namespace flashlog {
 
+#if MICROBIT_CODAL
+// the same flash can hold audio recordings instead
+static bool canLog() {
+    return claimFreeFlash(FREE_FLASH_LOG);
+}
+#endif
+
 /**
 * Creates a new row in the log, ready to be populated by logData()
 **/
@@ -35,6 +42,8 @@ namespace flashlog {
 //% group="micro:bit (V2)"
 int beginRow() {
 #if MICROBIT_CODAL
+    if (!canLog())
+        return DEVICE_NOT_SUPPORTED;
     return uBit.log.beginRow();
 #else
     return DEVICE_NOT_SUPPORTED;
@@ -52,6 +61,8 @@ int logData(String key, String value) {
     if (NULL == key || NULL == value)
         return DEVICE_INVALID_PARAMETER;
 #if MICROBIT_CODAL
+    if (!canLog())
+        return DEVICE_NOT_SUPPORTED;
     return uBit.log.logData(MSTR(key), MSTR(value));
 #else
     return DEVICE_NOT_SUPPORTED;
@@ -69,6 +80,8 @@ int logString(String value) {
     if (NULL == value)
         return DEVICE_INVALID_PARAMETER;
 #if MICROBIT_CODAL
+    if (!canLog())
+        return DEVICE_NOT_SUPPORTED;
     return uBit.log.logString(MSTR(value));
 #else
     return DEVICE_NOT_SUPPORTED;
@@ -84,6 +97,8 @@ int logString(String value) {
 //% group="micro:bit (V2)"
 int endRow() {
 #if MICROBIT_CODAL
+    if (!canLog())
+        return DEVICE_NOT_SUPPORTED;
     return uBit.log.endRow();
 #else
     return DEVICE_NOT_SUPPORTED;
@@ -99,7 +114,8 @@ int endRow() {
 //% group="micro:bit (V2)"
 void clear(bool fullErase) {
 #if MICROBIT_CODAL
-    uBit.log.clear(fullErase);
+    if (canLog())
+        uBit.log.clear(fullErase);
 #endif
 }
 
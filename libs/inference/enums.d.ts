@@ -0,0 +1,15 @@
+// Auto-generated. Do not edit.
+declare namespace inference {
+}
+
+
+    declare const enum SpectrumBandEvent {
+    //% block="rises above threshold"
+    Above = 1,
+    //% block="falls below threshold"
+    Below = 2,
+    }
+declare namespace spectrum {
+}
+
+// Auto-generated. Do not edit. Really.
@@ -0,0 +1,260 @@
+#include "pxt.h"
+
+// model: "I8N1", u8 number of layers, u8 reserved, u16 input length, then the layers
+#define MODEL_MAGIC 0x314e3849
+#define MODEL_HEADER_SIZE 8
+// layer: u8 type, u8 activation, u16 input length, u16 output length, u8 input channels,
+// u8 output channels, u8 kernel, u8 stride, i8 input zero point, i8 output zero point,
+// i32 multiplier, i8 shift, 3 bytes padding, then the int8 weights and int32 biases
+#define LAYER_HEADER_SIZE 20
+
+#define LAYER_DENSE 1
+#define LAYER_CONV1D 2
+#define LAYER_MAXPOOL1D 3
+
+#define ACTIVATION_NONE 0
+#define ACTIVATION_RELU 1
+
+/**
+ * Quantized neural network inference on sensor data.
+ */
+//%
+namespace inference {
+
+struct Layer {
+    int type;
+    int activation;
+    int inLength, outLength;
+    int inChannels, outChannels;
+    int kernel, stride;
+    int inZero, outZero;
+    int32_t multiplier;
+    int shift;
+    const int8_t *weights;
+    const uint8_t *biases;
+    int size;
+};
+
+static uint8_t *arena;
+static int arenaSize;
+
+// models usually live in flash as hex literals, so nothing in them is assumed to be aligned
+static inline uint16_t read16(const uint8_t *p) {
+    return p[0] | (p[1] << 8);
+}
+
+static inline int32_t read32(const uint8_t *p) {
+    return (int32_t)(p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24));
+}
+
+static bool parseLayer(const uint8_t *p, int avail, Layer *l) {
+    if (avail < LAYER_HEADER_SIZE)
+        return false;
+    l->type = p[0];
+    l->activation = p[1];
+    l->inLength = read16(p + 2);
+    l->outLength = read16(p + 4);
+    l->inChannels = p[6];
+    l->outChannels = p[7];
+    l->kernel = p[8];
+    l->stride = p[9];
+    l->inZero = (int8_t)p[10];
+    l->outZero = (int8_t)p[11];
+    l->multiplier = read32(p + 12);
+    l->shift = (int8_t)p[16];
+    l->weights = (const int8_t *)(p + LAYER_HEADER_SIZE);
+
+    // 64 bits, so that a corrupt header cannot wrap the size around and pass the check
+    int64_t numWeights = 0, numBiases = 0;
+    switch (l->type) {
+    case LAYER_DENSE:
+        if (l->inChannels != 1 || l->outChannels != 1)
+            return false;
+        numWeights = (int64_t)l->inLength * l->outLength;
+        numBiases = l->outLength;
+        break;
+    case LAYER_CONV1D:
+        if (!l->kernel || !l->stride || l->kernel > l->inLength ||
+            l->outLength != (l->inLength - l->kernel) / l->stride + 1)
+            return false;
+        numWeights = (int64_t)l->outChannels * l->kernel * l->inChannels;
+        numBiases = l->outChannels;
+        break;
+    case LAYER_MAXPOOL1D:
+        if (!l->kernel || l->inChannels != l->outChannels ||
+            l->outLength != l->inLength / l->kernel)
+            return false;
+        break;
+    default:
+        return false;
+    }
+    if (l->shift < -30 || l->shift > 31)
+        return false;
+    int64_t size = LAYER_HEADER_SIZE + numWeights + numBiases * 4;
+    if (size > avail)
+        return false;
+    l->biases = p + LAYER_HEADER_SIZE + numWeights;
+    l->size = (int)size;
+    return true;
+}
+
+// sum of (x[i] + offset) * w[i]
+static int32_t dotS8(const int8_t *x, const int8_t *w, int n, int32_t offset) {
+    int32_t acc = 0;
+    int32_t sumW = 0;
+    int i = 0;
+#if defined(__ARM_FEATURE_DSP)
+    // two int16 multiply-accumulates per instruction, as in CMSIS-NN
+    for (; i + 4 <= n; i += 4) {
+        uint32_t xv, wv;
+        memcpy(&xv, x + i, 4);
+        memcpy(&wv, w + i, 4);
+        uint32_t x02 = __SXTB16(xv), x13 = __SXTB16(__ROR(xv, 8));
+        uint32_t w02 = __SXTB16(wv), w13 = __SXTB16(__ROR(wv, 8));
+        acc = __SMLAD(x02, w02, acc);
+        acc = __SMLAD(x13, w13, acc);
+        sumW = __SMLAD(w02, 0x00010001, sumW);
+        sumW = __SMLAD(w13, 0x00010001, sumW);
+    }
+#else
+    for (; i + 4 <= n; i += 4) {
+        acc += x[i] * w[i] + x[i + 1] * w[i + 1] + x[i + 2] * w[i + 2] + x[i + 3] * w[i + 3];
+        sumW += w[i] + w[i + 1] + w[i + 2] + w[i + 3];
+    }
+#endif
+    for (; i < n; ++i) {
+        acc += x[i] * w[i];
+        sumW += w[i];
+    }
+    return acc + offset * sumW;
+}
+
+// acc * multiplier / 2^(31 + shift), rounded, then offset and clamped to int8
+static inline int8_t requantize(int32_t acc, const Layer *l) {
+    int total = 31 + l->shift;
+    int64_t p = (int64_t)acc * l->multiplier + ((int64_t)1 << (total - 1));
+    int32_t v = (int32_t)(p >> total) + l->outZero;
+    int lo = l->activation == ACTIVATION_RELU ? l->outZero : -128;
+    return v < lo ? lo : v > 127 ? 127 : v;
+}
+
+static void dense(const Layer *l, const int8_t *in, int8_t *out) {
+    for (int o = 0; o < l->outLength; ++o) {
+        int32_t acc = read32(l->biases + o * 4) +
+                      dotS8(in, l->weights + o * l->inLength, l->inLength, -l->inZero);
+        out[o] = requantize(acc, l);
+    }
+}
+
+// tensors are laid out as [length][channels], so a kernel window is contiguous
+static void conv1d(const Layer *l, const int8_t *in, int8_t *out) {
+    int window = l->kernel * l->inChannels;
+    for (int t = 0; t < l->outLength; ++t) {
+        const int8_t *x = in + t * l->stride * l->inChannels;
+        for (int c = 0; c < l->outChannels; ++c) {
+            int32_t acc =
+                read32(l->biases + c * 4) + dotS8(x, l->weights + c * window, window, -l->inZero);
+            *out++ = requantize(acc, l);
+        }
+    }
+}
+
+static void maxpool1d(const Layer *l, const int8_t *in, int8_t *out) {
+    int ch = l->inChannels;
+    for (int t = 0; t < l->outLength; ++t) {
+        const int8_t *x = in + t * l->kernel * ch;
+        for (int c = 0; c < ch; ++c) {
+            int m = x[c];
+            for (int k = 1; k < l->kernel; ++k)
+                m = max(m, (int)x[k * ch + c]);
+            *out++ = m;
+        }
+    }
+}
+
+/**
+ * Runs a quantized neural network on a buffer of int8 values, and returns its int8 outputs.
+ * Dense, 1D convolution and max pooling layers are supported; see the README for the format.
+ * @param model the model, typically a hex literal
+ * @param input the input values, as many as the model expects
+ * @returns null if the model is invalid or the input does not have the right length
+ */
+//%
+Buffer run(Buffer model, Buffer input) {
+    if (!model || !input || model->length < MODEL_HEADER_SIZE ||
+        (uint32_t)read32(model->data) != MODEL_MAGIC)
+        return NULL;
+    int numLayers = model->data[4];
+    int length = read16(model->data + 6);
+    if (numLayers == 0 || input->length != length)
+        return NULL;
+
+    // check the whole model first, and size the arena for the largest tensor
+    Layer l;
+    const uint8_t *p = model->data + MODEL_HEADER_SIZE;
+    const uint8_t *end = model->data + model->length;
+    int largest = length;
+    int channels = 1;
+    for (int i = 0; i < numLayers; ++i) {
+        if (!parseLayer(p, end - p, &l) || l.inLength * l.inChannels != length * channels)
+            return NULL;
+        length = l.outLength;
+        channels = l.outChannels;
+        largest = max(largest, length * channels);
+        p += l.size;
+    }
+
+    // two halves, each layer reads from one and writes to the other
+    if (arenaSize < 2 * largest) {
+        xfree(arena);
+        arenaSize = 2 * largest;
+        arena = (uint8_t *)xmalloc(arenaSize);
+    }
+    int8_t *in = (int8_t *)arena;
+    int8_t *out = (int8_t *)arena + largest;
+    memcpy(in, input->data, input->length);
+
+    p = model->data + MODEL_HEADER_SIZE;
+    for (int i = 0; i < numLayers; ++i) {
+        parseLayer(p, end - p, &l);
+        switch (l.type) {
+        case LAYER_DENSE:
+            dense(&l, in, out);
+            break;
+        case LAYER_CONV1D:
+            conv1d(&l, in, out);
+            break;
+        case LAYER_MAXPOOL1D:
+            maxpool1d(&l, in, out);
+            break;
+        }
+        int8_t *t = in;
+        in = out;
+        out = t;
+        p += l.size;
+    }
+
+    return mkBuffer((uint8_t *)in, length * channels);
+}
+
+/**
+ * Converts signed 16-bit samples, such as accelerometer or microphone blocks, into int8
+ * model inputs by shifting them right and saturating.
+ * @param samples signed 16-bit little endian samples
+ * @param shift number of bits to drop, eg: 5
+ */
+//%
+Buffer quantizeInt16(Buffer samples, int shift) {
+    if (!samples)
+        return NULL;
+    int n = samples->length / 2;
+    Buffer res = mkBuffer(NULL, n);
+    shift = max(0, min(shift, 15));
+    for (int i = 0; i < n; ++i) {
+        int v = (int16_t)read16(samples->data + i * 2) >> shift;
+        res->data[i] = v < -128 ? -128 : v > 127 ? 127 : v;
+    }
+    return res;
+}
+
+} // namespace inference
@@ -0,0 +1,85 @@
+// Auto-generated. Do not edit.
+
+
+    /**
+     * Quantized neural network inference on sensor data.
+     */
+    //%
+declare namespace inference {
+
+    /**
+     * Runs a quantized neural network on a buffer of int8 values, and returns its int8 outputs.
+     * Dense, 1D convolution and max pooling layers are supported; see the README for the format.
+     * @param model the model, typically a hex literal
+     * @param input the input values, as many as the model expects
+     * @returns null if the model is invalid or the input does not have the right length
+     */
+    //% shim=inference::run
+    function run(model: Buffer, input: Buffer): Buffer;
+
+    /**
+     * Converts signed 16-bit samples, such as accelerometer or microphone blocks, into int8
+     * model inputs by shifting them right and saturating.
+     * @param samples signed 16-bit little endian samples
+     * @param shift number of bits to drop, eg: 5
+     */
+    //% shim=inference::quantizeInt16
+    function quantizeInt16(samples: Buffer, shift: int32): Buffer;
+}
+
+
+    /**
+     * Frequency analysis of sensor data.
+     */
+    //%
+declare namespace spectrum {
+
+    /**
+     * Computes the spectrum of a block of signed 16-bit samples, such as a microphone or
+     * accelerometer block. Only the first power of two number of samples (up to 1024) is used.
+     * A sine of amplitude A shows as A / 4 in its bin, or A / 8 with the window.
+     * @param samples signed 16-bit little endian samples
+     * @param window whether to apply a Hann window first, to reduce leakage between bins
+     * @returns unsigned 16-bit magnitudes of the bins from 0 up to half the sample rate, or null
+     * if there are fewer than 4 samples
+     */
+    //% window.defl=1 shim=spectrum::magnitudes
+    function magnitudes(samples: Buffer, window?: boolean): Buffer;
+
+    /**
+     * Configures a frequency band watched by ``analyze``.
+     * @param band band number, from 0 to 7
+     * @param low lowest frequency of the band in Hz, eg: 200
+     * @param high highest frequency of the band in Hz, eg: 400
+     * @param threshold band energy that raises the events, eg: 100
+     */
+    //% shim=spectrum::setBand
+    function setBand(band: int32, low: int32, high: int32, threshold: int32): void;
+
+    /**
+     * Computes the spectrum of a block of samples and updates the energy of each configured
+     * band, raising events for bands crossing their threshold.
+     * @param samples signed 16-bit little endian samples
+     * @param sampleRate the sample rate of the block in Hz, eg: 11000
+     */
+    //% shim=spectrum::analyze
+    function analyze(samples: Buffer, sampleRate: int32): void;
+
+    /**
+     * Gets the energy of a band from the last ``analyze``, as its average bin magnitude.
+     * @param band band number, from 0 to 7
+     */
+    //% shim=spectrum::bandEnergy
+    function bandEnergy(band: int32): int32;
+
+    /**
+     * Runs code when the energy of a band crosses its threshold.
+     * @param band band number, from 0 to 7
+     * @param event whether to run when the energy rises above or falls below the threshold
+     * @param handler code to run
+     */
+    //% shim=spectrum::onBandEnergy
+    function onBandEnergy(band: int32, event: SpectrumBandEvent, handler: () => void): void;
+}
+
+// Auto-generated. Do not edit. Really.
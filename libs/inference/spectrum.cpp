@@ -0,0 +1,253 @@
+#include "pxt.h"
+
+#define SPECTRUM_ID 9515
+
+#define SPECTRUM_MAX_POINTS 1024
+#define SPECTRUM_LOG2_MAX_POINTS 10
+
+#ifndef SPECTRUM_MAX_BANDS
+#define SPECTRUM_MAX_BANDS 8
+#endif
+
+enum class SpectrumBandEvent {
+    //% block="rises above threshold"
+    Above = 1,
+    //% block="falls below threshold"
+    Below = 2,
+};
+
+/**
+ * Frequency analysis of sensor data.
+ */
+//%
+namespace spectrum {
+
+// a quarter of a sine wave over SPECTRUM_MAX_POINTS, in Q15
+static const int16_t quarterSine[SPECTRUM_MAX_POINTS / 4 + 1] = {
+    0, 201, 402, 603, 804, 1005, 1206, 1407, 1608, 1809, 2009, 2210,
+    2410, 2611, 2811, 3012, 3212, 3412, 3612, 3811, 4011, 4210, 4410, 4609,
+    4808, 5007, 5205, 5404, 5602, 5800, 5998, 6195, 6393, 6590, 6786, 6983,
+    7179, 7375, 7571, 7767, 7962, 8157, 8351, 8545, 8739, 8933, 9126, 9319,
+    9512, 9704, 9896, 10087, 10278, 10469, 10659, 10849, 11039, 11228, 11417, 11605,
+    11793, 11980, 12167, 12353, 12539, 12725, 12910, 13094, 13279, 13462, 13645, 13828,
+    14010, 14191, 14372, 14553, 14732, 14912, 15090, 15269, 15446, 15623, 15800, 15976,
+    16151, 16325, 16499, 16673, 16846, 17018, 17189, 17360, 17530, 17700, 17869, 18037,
+    18204, 18371, 18537, 18703, 18868, 19032, 19195, 19357, 19519, 19680, 19841, 20000,
+    20159, 20317, 20475, 20631, 20787, 20942, 21096, 21250, 21403, 21554, 21705, 21856,
+    22005, 22154, 22301, 22448, 22594, 22739, 22884, 23027, 23170, 23311, 23452, 23592,
+    23731, 23870, 24007, 24143, 24279, 24413, 24547, 24680, 24811, 24942, 25072, 25201,
+    25329, 25456, 25582, 25708, 25832, 25955, 26077, 26198, 26319, 26438, 26556, 26674,
+    26790, 26905, 27019, 27133, 27245, 27356, 27466, 27575, 27683, 27790, 27896, 28001,
+    28105, 28208, 28310, 28411, 28510, 28609, 28706, 28803, 28898, 28992, 29085, 29177,
+    29268, 29358, 29447, 29534, 29621, 29706, 29791, 29874, 29956, 30037, 30117, 30195,
+    30273, 30349, 30424, 30498, 30571, 30643, 30714, 30783, 30852, 30919, 30985, 31050,
+    31113, 31176, 31237, 31297, 31356, 31414, 31470, 31526, 31580, 31633, 31685, 31736,
+    31785, 31833, 31880, 31926, 31971, 32014, 32057, 32098, 32137, 32176, 32213, 32250,
+    32285, 32318, 32351, 32382, 32412, 32441, 32469, 32495, 32521, 32545, 32567, 32589,
+    32609, 32628, 32646, 32663, 32678, 32692, 32705, 32717, 32728, 32737, 32745, 32752,
+    32757, 32761, 32765, 32766, 32767,
+};
+
+// sin(2 pi i / SPECTRUM_MAX_POINTS) for i in [0, SPECTRUM_MAX_POINTS)
+static int sine(int i) {
+    const int q = SPECTRUM_MAX_POINTS / 4;
+    if (i < q)
+        return quarterSine[i];
+    if (i < 2 * q)
+        return quarterSine[2 * q - i];
+    if (i < 3 * q)
+        return -quarterSine[i - 2 * q];
+    return -quarterSine[4 * q - i];
+}
+
+static inline int mulQ15(int a, int b) {
+    return (a * b + (1 << 14)) >> 15;
+}
+
+/**
+ * In-place radix-2 decimation in time FFT over n int16 complex values, n a power of two.
+ * Every stage halves its outputs, so the magnitude of the values never grows and the result
+ * is scaled by 1/n; inputs must have a magnitude below 2^15 / sqrt(2).
+ */
+static void fft(int16_t *re, int16_t *im, int n) {
+    for (int i = 1, j = 0; i < n; ++i) {
+        int bit = n >> 1;
+        for (; j & bit; bit >>= 1)
+            j ^= bit;
+        j |= bit;
+        if (i < j) {
+            int16_t t = re[i];
+            re[i] = re[j];
+            re[j] = t;
+            t = im[i];
+            im[i] = im[j];
+            im[j] = t;
+        }
+    }
+
+    int step = SPECTRUM_LOG2_MAX_POINTS - 1;
+    for (int half = 1; half < n; half <<= 1, --step) {
+        for (int m = 0; m < half; ++m) {
+            int k = m << step;
+            int wr = sine(k + SPECTRUM_MAX_POINTS / 4) >> 1;
+            int wi = -sine(k) >> 1;
+            for (int i = m; i < n; i += half << 1) {
+                int j = i + half;
+                int tr = mulQ15(wr, re[j]) - mulQ15(wi, im[j]);
+                int ti = mulQ15(wr, im[j]) + mulQ15(wi, re[j]);
+                int qr = re[i] >> 1, qi = im[i] >> 1;
+                re[j] = qr - tr;
+                im[j] = qi - ti;
+                re[i] = qr + tr;
+                im[i] = qi + ti;
+            }
+        }
+    }
+}
+
+// the largest power of two number of int16 samples in a buffer, capped to the sine table
+static int fftPoints(Buffer samples) {
+    if (!samples)
+        return 0;
+    int n = 4;
+    while (n * 2 <= SPECTRUM_MAX_POINTS && (int)samples->length >= n * 2 * 2)
+        n <<= 1;
+    return (int)samples->length >= n * 2 ? n : 0;
+}
+
+// magnitudes of the first n / 2 bins of n int16 samples, Hann windowed if asked
+static void computeMagnitudes(Buffer samples, int n, bool window, uint16_t *out) {
+    int log2n = 0;
+    while ((1 << log2n) < n)
+        log2n++;
+
+    int16_t *re = (int16_t *)xmalloc(n * 2 * sizeof(int16_t));
+    int16_t *im = re + n;
+    int stride = SPECTRUM_MAX_POINTS >> log2n;
+    for (int i = 0; i < n; ++i) {
+        int v = (int16_t)(samples->data[2 * i] | (samples->data[2 * i + 1] << 8));
+        if (window)
+            // 0.5 - 0.5 cos(2 pi i / n)
+            v = mulQ15(v, (32767 - sine((i * stride + SPECTRUM_MAX_POINTS / 4) %
+                                        SPECTRUM_MAX_POINTS)) >> 1);
+        // keeps full scale input within what the FFT accepts
+        re[i] = v >> 1;
+        im[i] = 0;
+    }
+    fft(re, im, n);
+    for (int i = 0; i < n / 2; ++i)
+        out[i] = isqrt((uint32_t)(re[i] * re[i]) + (uint32_t)(im[i] * im[i]));
+    xfree(re);
+}
+
+/**
+ * Computes the spectrum of a block of signed 16-bit samples, such as a microphone or
+ * accelerometer block. Only the first power of two number of samples (up to 1024) is used.
+ * A sine of amplitude A shows as A / 4 in its bin, or A / 8 with the window.
+ * @param samples signed 16-bit little endian samples
+ * @param window whether to apply a Hann window first, to reduce leakage between bins
+ * @returns unsigned 16-bit magnitudes of the bins from 0 up to half the sample rate, or null
+ * if there are fewer than 4 samples
+ */
+//%
+Buffer magnitudes(Buffer samples, bool window = true) {
+    int n = fftPoints(samples);
+    if (!n)
+        return NULL;
+    Buffer res = mkBuffer(NULL, n);
+    computeMagnitudes(samples, n, window, (uint16_t *)res->data);
+    return res;
+}
+
+struct Band {
+    int low, high;
+    int threshold;
+    int level;
+    bool above;
+};
+
+static Band *bands[SPECTRUM_MAX_BANDS];
+
+/**
+ * Configures a frequency band watched by analyze.
+ * @param band band number, from 0 to 7
+ * @param low lowest frequency of the band in Hz, eg: 200
+ * @param high highest frequency of the band in Hz, eg: 400
+ * @param threshold band energy that raises the events, eg: 100
+ */
+//%
+void setBand(int band, int low, int high, int threshold) {
+    if (band < 0 || band >= SPECTRUM_MAX_BANDS)
+        return;
+    if (!bands[band])
+        bands[band] = new Band();
+    Band *b = bands[band];
+    b->low = low;
+    b->high = max(low, high);
+    b->threshold = threshold;
+    b->level = 0;
+    b->above = false;
+}
+
+/**
+ * Computes the spectrum of a block of samples and updates the energy of each configured
+ * band, raising events for bands crossing their threshold.
+ * @param samples signed 16-bit little endian samples
+ * @param sampleRate the sample rate of the block in Hz, eg: 11000
+ */
+//%
+void analyze(Buffer samples, int sampleRate) {
+    int n = fftPoints(samples);
+    if (sampleRate <= 0 || !n)
+        return;
+    uint16_t *mags = (uint16_t *)xmalloc(n / 2 * sizeof(uint16_t));
+    computeMagnitudes(samples, n, true, mags);
+    for (int i = 0; i < SPECTRUM_MAX_BANDS; ++i) {
+        Band *b = bands[i];
+        if (!b)
+            continue;
+        int from = max(0, (b->low * n + sampleRate - 1) / sampleRate);
+        int to = min(n / 2 - 1, b->high * n / sampleRate);
+        // a band narrower than a bin still follows its nearest bin
+        if (from > to)
+            from = to = min(n / 2 - 1, (b->low * n + sampleRate / 2) / sampleRate);
+        uint32_t sum = 0;
+        for (int k = from; k <= to; ++k)
+            sum += mags[k];
+        b->level = sum / (to - from + 1);
+
+        // half the threshold of hysteresis, so a level hovering around it does not chatter
+        if (!b->above && b->level > b->threshold) {
+            b->above = true;
+            MicroBitEvent(SPECTRUM_ID, i * 2 + (int)SpectrumBandEvent::Above);
+        } else if (b->above && b->level < b->threshold / 2) {
+            b->above = false;
+            MicroBitEvent(SPECTRUM_ID, i * 2 + (int)SpectrumBandEvent::Below);
+        }
+    }
+    xfree(mags);
+}
+
+/**
+ * Gets the energy of a band from the last analyze, as its average bin magnitude.
+ * @param band band number, from 0 to 7
+ */
+//%
+int bandEnergy(int band) {
+    if (band < 0 || band >= SPECTRUM_MAX_BANDS || !bands[band])
+        return 0;
+    return bands[band]->level;
+}
+
+/**
+ * Runs code when the energy of a band crosses its threshold.
+ * @param band band number, from 0 to 7
+ * @param event whether to run when the energy rises above or falls below the threshold
+ * @param handler code to run
+ */
+//%
+void onBandEnergy(int band, SpectrumBandEvent event, Action handler) {
+    registerWithDal(SPECTRUM_ID, band * 2 + (int)event, handler);
+}
+
+} // namespace spectrum
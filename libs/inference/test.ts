@@ -0,0 +1,166 @@
+// Builds a small conv1d -> maxpool -> dense model and checks the native kernels
+// against a straightforward reference implementation of the same arithmetic.
+const rand = new Math.FastRandom(7)
+function nextInt8() {
+    return rand.randomRange(-128, 127)
+}
+
+const layers = [
+    // type, activation, inLength, outLength, inChannels, outChannels, kernel, stride, inZero, outZero, multiplier, shift
+    [2, 1, 8, 6, 3, 4, 3, 1, 3, -5, 1 << 20, -1],
+    [3, 0, 6, 3, 4, 4, 2, 2, 0, 0, 0, 0],
+    [1, 0, 12, 3, 1, 1, 0, 0, -5, 2, 3 << 18, 0],
+]
+
+function weightCount(l: number[]) {
+    if (l[0] == 1) return l[2] * l[3]
+    if (l[0] == 2) return l[5] * l[6] * l[4]
+    return 0
+}
+
+function biasCount(l: number[]) {
+    if (l[0] == 1) return l[3]
+    if (l[0] == 2) return l[5]
+    return 0
+}
+
+let size = 8
+for (const l of layers)
+    size += 20 + weightCount(l) + 4 * biasCount(l)
+const model = pins.createBuffer(size)
+model.setNumber(NumberFormat.UInt32LE, 0, 0x314e3849)
+model.setNumber(NumberFormat.UInt8LE, 4, layers.length)
+model.setNumber(NumberFormat.UInt16LE, 6, 24)
+let offset = 8
+for (const l of layers) {
+    model.setNumber(NumberFormat.UInt8LE, offset, l[0])
+    model.setNumber(NumberFormat.UInt8LE, offset + 1, l[1])
+    model.setNumber(NumberFormat.UInt16LE, offset + 2, l[2])
+    model.setNumber(NumberFormat.UInt16LE, offset + 4, l[3])
+    model.setNumber(NumberFormat.UInt8LE, offset + 6, l[4])
+    model.setNumber(NumberFormat.UInt8LE, offset + 7, l[5])
+    model.setNumber(NumberFormat.UInt8LE, offset + 8, l[6])
+    model.setNumber(NumberFormat.UInt8LE, offset + 9, l[7])
+    model.setNumber(NumberFormat.Int8LE, offset + 10, l[8])
+    model.setNumber(NumberFormat.Int8LE, offset + 11, l[9])
+    model.setNumber(NumberFormat.Int32LE, offset + 12, l[10])
+    model.setNumber(NumberFormat.Int8LE, offset + 16, l[11])
+    offset += 20
+    for (let i = 0; i < weightCount(l); ++i)
+        model.setNumber(NumberFormat.Int8LE, offset++, nextInt8())
+    for (let i = 0; i < biasCount(l); ++i) {
+        model.setNumber(NumberFormat.Int32LE, offset, nextInt8() * 16)
+        offset += 4
+    }
+}
+
+function requantize(acc: number, l: number[]) {
+    const total = 31 + l[11]
+    const v = Math.floor((acc * l[10] + Math.pow(2, total - 1)) / Math.pow(2, total)) + l[9]
+    const lo = l[1] == 1 ? l[9] : -128
+    return Math.max(lo, Math.min(127, v))
+}
+
+function reference(input: number[]) {
+    let x = input
+    let p = 8
+    for (const l of layers) {
+        const w = p + 20
+        const b = w + weightCount(l)
+        const out: number[] = []
+        if (l[0] == 1) {
+            for (let o = 0; o < l[3]; ++o) {
+                let acc = model.getNumber(NumberFormat.Int32LE, b + o * 4)
+                for (let i = 0; i < l[2]; ++i)
+                    acc += (x[i] - l[8]) * model.getNumber(NumberFormat.Int8LE, w + o * l[2] + i)
+                out.push(requantize(acc, l))
+            }
+        } else if (l[0] == 2) {
+            const window = l[6] * l[4]
+            for (let t = 0; t < l[3]; ++t)
+                for (let c = 0; c < l[5]; ++c) {
+                    let acc = model.getNumber(NumberFormat.Int32LE, b + c * 4)
+                    for (let k = 0; k < window; ++k)
+                        acc += (x[t * l[7] * l[4] + k] - l[8]) * model.getNumber(NumberFormat.Int8LE, w + c * window + k)
+                    out.push(requantize(acc, l))
+                }
+        } else {
+            for (let t = 0; t < l[3]; ++t)
+                for (let c = 0; c < l[4]; ++c) {
+                    let m = -128
+                    for (let k = 0; k < l[6]; ++k)
+                        m = Math.max(m, x[(t * l[6] + k) * l[4] + c])
+                    out.push(m)
+                }
+        }
+        x = out
+        p = b + 4 * biasCount(l)
+    }
+    return x
+}
+
+for (let run = 0; run < 5; ++run) {
+    const input = pins.createBuffer(24)
+    const values: number[] = []
+    for (let i = 0; i < 24; ++i) {
+        const v = nextInt8()
+        values.push(v)
+        input.setNumber(NumberFormat.Int8LE, i, v)
+    }
+    const expected = reference(values)
+    const actual = inference.run(model, input)
+    control.assert(actual && actual.length == expected.length, "output length")
+    for (let i = 0; i < expected.length; ++i)
+        control.assert(actual.getNumber(NumberFormat.Int8LE, i) == expected[i], "output " + i)
+}
+
+control.assert(!inference.run(model, pins.createBuffer(10)), "input length")
+
+const samples = pins.createBuffer(6)
+samples.setNumber(NumberFormat.Int16LE, 0, 1000)
+samples.setNumber(NumberFormat.Int16LE, 2, -9000)
+samples.setNumber(NumberFormat.Int16LE, 4, -40)
+const q = inference.quantizeInt16(samples, 5)
+control.assert(q.getNumber(NumberFormat.Int8LE, 0) == 31, "quantize")
+control.assert(q.getNumber(NumberFormat.Int8LE, 1) == -128, "saturate")
+control.assert(q.getNumber(NumberFormat.Int8LE, 2) == -2, "round down")
+
+// Compares the fixed-point FFT with a double precision DFT of the same signal, with the same
+// 1 / (2n) scaling, and times it.
+function testSpectrum() {
+    const n = 256
+    const rate = 8000
+    const samples = pins.createBuffer(n * 2)
+    const values: number[] = []
+    for (let i = 0; i < n; ++i) {
+        const v = Math.round(8000 * Math.sin(2 * Math.PI * 1000 * i / rate)
+            + 3000 * Math.sin(2 * Math.PI * 2500 * i / rate))
+        values.push(v)
+        samples.setNumber(NumberFormat.Int16LE, i * 2, v)
+    }
+
+    const start = control.micros()
+    const mags = spectrum.magnitudes(samples, false)
+    console.log(`fft ${n} points: ${control.micros() - start} us`)
+    control.assert(mags.length == n, "fft length")
+
+    for (let k = 0; k < n / 2; ++k) {
+        let re = 0, im = 0
+        for (let i = 0; i < n; ++i) {
+            re += values[i] * Math.cos(2 * Math.PI * k * i / n)
+            im -= values[i] * Math.sin(2 * Math.PI * k * i / n)
+        }
+        const expected = Math.sqrt(re * re + im * im) / (2 * n)
+        const actual = mags.getNumber(NumberFormat.UInt16LE, k * 2)
+        control.assert(Math.abs(actual - expected) <= 8 + expected / 100, "fft bin " + k)
+    }
+
+    spectrum.setBand(0, 900, 1100, 200)
+    spectrum.setBand(1, 3000, 3500, 200)
+    spectrum.analyze(samples, rate)
+    control.assert(spectrum.bandEnergy(0) > 200, "band with the tone")
+    control.assert(spectrum.bandEnergy(1) < 20, "band without a tone")
+}
+testSpectrum()
+
+basic.showIcon(IconNames.Yes)
@@ -16,4 +16,22 @@
     Quiet = 1,
     }
 
+
+    declare const enum MicrophoneSampleFormat {
+    //% block="8 bit"
+    Int8 = 1,
+    //% block="16 bit"
+    Int16 = 2,
+    }
+
+
+    declare const enum SoundActivity {
+    //% block="clap"
+    Clap = 1,
+    //% block="voice start"
+    VoiceStart = 2,
+    //% block="voice end"
+    VoiceEnd = 3,
+    }
+
 // Auto-generated. Do not edit. Really.
@@ -8,6 +8,18 @@
 #define MICROPHONE_MIN 52.0f
 #define MICROPHONE_MAX 120.0f
 
+#define MICROPHONE_STREAM_ID 9514
+#define MICROPHONE_STREAM_EVT_BLOCK 1
+
+#ifndef MICROPHONE_STREAM_BLOCKS
+#define MICROPHONE_STREAM_BLOCKS 4
+#endif
+
+#define SOUND_ACTIVITY_ID 9517
+#define SOUND_ACTIVITY_RATE 4000
+// 20ms frames
+#define SOUND_ACTIVITY_FRAME (SOUND_ACTIVITY_RATE / 50)
+
 enum class DetectedSound {
     //% block="loud"
     Loud = 2,
@@ -21,6 +33,22 @@ enum class SoundThreshold {
     //% block="quiet"
     Quiet = 1
 };
+
+enum class MicrophoneSampleFormat {
+    //% block="8 bit"
+    Int8 = 1,
+    //% block="16 bit"
+    Int16 = 2
+};
+
+enum class SoundActivity {
+    //% block="clap"
+    Clap = 1,
+    //% block="voice start"
+    VoiceStart = 2,
+    //% block="voice end"
+    VoiceEnd = 3
+};
 namespace input {
 
 /**
@@ -89,4 +117,326 @@ void setSoundThreshold(SoundThreshold sound, int threshold) {
     target_panic(PANIC_VARIANT_NOT_SUPPORTED);
 #endif
 }
+
+#if MICROBIT_CODAL
+/**
+ * Pulls PCM blocks from a channel of the microphone splitter, converts them to signed samples
+ * of the requested width and packs them into a block ring, raising an event each time a block
+ * is full. Pull requests come from the audio interrupt, which the ring allows for.
+ */
+class MicrophoneStream : public DataSink {
+  public:
+    DataSource &source;
+    BlockRing ring;
+
+    MicrophoneStream(DataSource &source)
+        : source(source),
+          ring(MICROPHONE_STREAM_BLOCKS, MICROPHONE_STREAM_ID, MICROPHONE_STREAM_EVT_BLOCK) {}
+
+    static int readSigned16(const uint8_t *p, int format) {
+        switch (format) {
+        case DATASTREAM_FORMAT_8BIT_UNSIGNED:
+            return (p[0] - 128) << 8;
+        case DATASTREAM_FORMAT_8BIT_SIGNED:
+            return (int8_t)p[0] << 8;
+        case DATASTREAM_FORMAT_16BIT_UNSIGNED:
+            return (p[0] | (p[1] << 8)) - 32768;
+        default:
+            return (int16_t)(p[0] | (p[1] << 8));
+        }
+    }
+
+    virtual int pullRequest() override {
+        // always pull, so that the rest of the audio pipeline keeps flowing
+        ManagedBuffer b = source.pull();
+        if (!ring.running)
+            return DEVICE_OK;
+        int format = source.getFormat();
+        int width = DATASTREAM_FORMAT_BYTES_PER_SAMPLE(format);
+        if (width != 1 && width != 2)
+            return DEVICE_OK;
+        const uint8_t *p = b.getBytes();
+        for (int i = 0; i + width <= b.length(); i += width) {
+            int v = readSigned16(p + i, format);
+            // little endian, keeping the high byte for 8-bit samples
+            uint8_t sample[2] = {(uint8_t)(ring.sampleSize == 1 ? v >> 8 : v), (uint8_t)(v >> 8)};
+            ring.write(sample);
+        }
+        return DEVICE_OK;
+    }
+
+    // must be called from a fiber
+    void start(int bytes, int samples) {
+        ring.start(bytes, samples);
+        if (!source.isConnected())
+            source.connect(*this);
+    }
+
+    // must be called from a fiber; blocks already full can still be read
+    void stop() {
+        ring.stop();
+        // once no channel of the splitter is connected, the microphone is turned off
+        __disable_irq();
+        source.disconnect();
+        __enable_irq();
+    }
+};
+
+static MicrophoneStream *microphoneStream;
+static SplitterChannel *microphoneStreamChannel;
+#endif
+
+/**
+ * Streams raw samples from the microphone in the background, in blocks of signed 8 or
+ * 16-bit little endian samples.
+ * @param sampleRate samples per second, eg: 11000
+ * @param samplesPerBlock number of samples in each block, eg: 256
+ * @param format the size of each sample
+ */
+//% parts="microphone" advanced=true
+//% group="micro:bit (V2)"
+void startMicrophoneStream(int sampleRate, int samplesPerBlock,
+                           MicrophoneSampleFormat format = MicrophoneSampleFormat::Int16) {
+#if MICROBIT_CODAL
+    if (!microphoneStream) {
+        MicroBitAudio::requestActivation();
+        microphoneStreamChannel = uBit.audio.splitter->createChannel();
+        microphoneStream = new MicrophoneStream(*microphoneStreamChannel);
+    }
+    microphoneStreamChannel->requestSampleRate(max(1, sampleRate));
+    microphoneStream->start((int)format, max(1, min(samplesPerBlock, 4096)));
+#else
+    target_panic(PANIC_VARIANT_NOT_SUPPORTED);
+#endif
+}
+
+/**
+ * Stops the microphone stream.
+ */
+//% parts="microphone" advanced=true
+//% group="micro:bit (V2)"
+void stopMicrophoneStream() {
+#if MICROBIT_CODAL
+    if (microphoneStream)
+        microphoneStream->stop();
+#endif
+}
+
+/**
+ * Takes the oldest full block of samples from the microphone stream.
+ * @returns null if no block is available
+ */
+//% parts="microphone" advanced=true
+//% group="micro:bit (V2)"
+Buffer readMicrophoneBlock() {
+#if MICROBIT_CODAL
+    return microphoneStream ? microphoneStream->ring.read() : NULL;
+#else
+    return NULL;
+#endif
+}
+
+/**
+ * Runs code each time a block of microphone samples is ready.
+ * @param handler code to run, typically calling ``readMicrophoneBlock``
+ */
+//% parts="microphone" advanced=true
+//% group="micro:bit (V2)"
+void onMicrophoneBlock(Action handler) {
+#if MICROBIT_CODAL
+    registerWithDal(MICROPHONE_STREAM_ID, MICROPHONE_STREAM_EVT_BLOCK, handler);
+#else
+    target_panic(PANIC_VARIANT_NOT_SUPPORTED);
+#endif
+}
+
+/**
+ * Gets the number of microphone samples dropped because no block was free.
+ */
+//% parts="microphone" advanced=true
+//% group="micro:bit (V2)"
+int microphoneStreamOverruns() {
+#if MICROBIT_CODAL
+    return microphoneStream ? microphoneStream->ring.overruns : 0;
+#else
+    return 0;
+#endif
+}
+
+#if MICROBIT_CODAL
+/**
+ * Detects claps and voices on its own low rate splitter channel, so it costs a few operations
+ * per decimated sample and does not need the level detector to run.
+ * Samples are grouped into 20ms frames of mean absolute level and zero crossings, compared
+ * against a background level that follows quiet periods quickly and loud ones slowly.
+ * A clap is a sudden jump above the background that dies down within a few frames; a voice
+ * is a run of frames above the background with a zero crossing rate in the speech range.
+ */
+class SoundActivityDetector : public DataSink {
+  public:
+    DataSource &source;
+    int32_t dc; // 8 bit fraction
+    int previous;
+    uint32_t frameSum;
+    int frameCrossings;
+    int frameSamples;
+    int32_t background; // 8 bit fraction
+    int lastLevel;
+    // thresholds are multiples of the background level, with a 4 bit fraction
+    int clapThreshold;
+    int voiceThreshold;
+    int clapPeak;
+    int clapFrames;
+    int clapHoldoff;
+    int voiceFrames;
+    int silentFrames;
+    volatile bool voice;
+
+    SoundActivityDetector(DataSource &source)
+        : source(source), dc(0), previous(0), frameSum(0), frameCrossings(0), frameSamples(0),
+          background(64 << 8), lastLevel(0), clapPeak(0), clapFrames(0), clapHoldoff(0),
+          voiceFrames(0), silentFrames(0), voice(false) {
+        clapThreshold = threshold(128);
+        voiceThreshold = threshold(128);
+        source.connect(*this);
+    }
+
+    // 2x the background at full sensitivity, up to 16x at none
+    static int threshold(int sensitivity) {
+        return 32 + (255 - max(0, min(255, sensitivity))) * 224 / 255;
+    }
+
+    void onFrame(int level, int crossings) {
+        int floor = max(8, (int)(background >> 8));
+
+        if (clapHoldoff)
+            clapHoldoff--;
+        if (clapFrames) {
+            clapPeak = max(clapPeak, level);
+            if (level * 4 < clapPeak) {
+                clapFrames = 0;
+                clapHoldoff = 10;
+                MicroBitEvent(SOUND_ACTIVITY_ID, (int)SoundActivity::Clap);
+            } else if (++clapFrames > 4) {
+                // too long for a clap
+                clapFrames = 0;
+            }
+        } else if (!clapHoldoff && level * 16 > floor * clapThreshold && level > lastLevel * 3) {
+            clapPeak = level;
+            clapFrames = 1;
+        }
+
+        // voiced speech sits between about 100Hz and 1kHz
+        bool speech = level * 16 > floor * voiceThreshold && crossings >= 2 &&
+                      crossings <= SOUND_ACTIVITY_FRAME / 2;
+        if (speech) {
+            silentFrames = 0;
+            if (!voice && ++voiceFrames >= 3) {
+                voice = true;
+                MicroBitEvent(SOUND_ACTIVITY_ID, (int)SoundActivity::VoiceStart);
+            }
+        } else {
+            voiceFrames = 0;
+            if (voice && ++silentFrames >= 15) {
+                voice = false;
+                silentFrames = 0;
+                MicroBitEvent(SOUND_ACTIVITY_ID, (int)SoundActivity::VoiceEnd);
+            }
+        }
+
+        int32_t target = level << 8;
+        if (target < background)
+            background -= (background - target) >> 2;
+        else if (!voice && !clapFrames)
+            background += (target - background) >> 7;
+        lastLevel = level;
+    }
+
+    virtual int pullRequest() override {
+        ManagedBuffer b = source.pull();
+        int format = source.getFormat();
+        int width = DATASTREAM_FORMAT_BYTES_PER_SAMPLE(format);
+        if (width != 1 && width != 2)
+            return DEVICE_OK;
+        const uint8_t *p = b.getBytes();
+        for (int i = 0; i + width <= b.length(); i += width) {
+            int v = MicrophoneStream::readSigned16(p + i, format);
+            // remove the DC offset with a one pole high pass filter
+            dc += ((v << 8) - dc) >> 6;
+            v -= dc >> 8;
+            frameSum += v < 0 ? -v : v;
+            if ((v < 0) != (previous < 0))
+                frameCrossings++;
+            previous = v;
+            if (++frameSamples == SOUND_ACTIVITY_FRAME) {
+                onFrame(frameSum / SOUND_ACTIVITY_FRAME, frameCrossings);
+                frameSum = 0;
+                frameCrossings = 0;
+                frameSamples = 0;
+            }
+        }
+        return DEVICE_OK;
+    }
+};
+
+static SoundActivityDetector *soundActivityDetector;
+
+static SoundActivityDetector *getSoundActivityDetector() {
+    if (!soundActivityDetector) {
+        MicroBitAudio::requestActivation();
+        SplitterChannel *channel = uBit.audio.splitter->createChannel();
+        channel->requestSampleRate(SOUND_ACTIVITY_RATE);
+        soundActivityDetector = new SoundActivityDetector(*channel);
+    }
+    return soundActivityDetector;
+}
+#endif
+
+/**
+ * Runs code when a clap, or the start or end of someone speaking, is heard.
+ * @param activity the kind of sound to listen for
+ * @param handler code to run
+ */
+//% parts="microphone" advanced=true
+//% group="micro:bit (V2)"
+void onSoundActivity(SoundActivity activity, Action handler) {
+#if MICROBIT_CODAL
+    getSoundActivityDetector();
+    registerWithDal(SOUND_ACTIVITY_ID, (int)activity, handler);
+#else
+    target_panic(PANIC_VARIANT_NOT_SUPPORTED);
+#endif
+}
+
+/**
+ * Sets how easily claps or voices are detected. Voice start and end share a sensitivity.
+ * @param activity the kind of sound to configure
+ * @param sensitivity from 0 (only very loud sounds) to 255 (the faintest sounds), eg: 128
+ */
+//% parts="microphone" advanced=true
+//% group="micro:bit (V2)"
+void setSoundActivitySensitivity(SoundActivity activity, int sensitivity) {
+#if MICROBIT_CODAL
+    SoundActivityDetector *d = getSoundActivityDetector();
+    if (activity == SoundActivity::Clap)
+        d->clapThreshold = SoundActivityDetector::threshold(sensitivity);
+    else
+        d->voiceThreshold = SoundActivityDetector::threshold(sensitivity);
+#else
+    target_panic(PANIC_VARIANT_NOT_SUPPORTED);
+#endif
+}
+
+/**
+ * Tells whether someone is speaking, as heard by the voice detector.
+ */
+//% parts="microphone" advanced=true
+//% group="micro:bit (V2)"
+bool isVoiceActive() {
+#if MICROBIT_CODAL
+    return getSoundActivityDetector()->voice;
+#else
+    return false;
+#endif
+}
 }
\ No newline at end of file
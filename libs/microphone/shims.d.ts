@@ -32,6 +32,72 @@ declare namespace input {
     //% advanced=true
     //% group="micro:bit (V2)" threshold.defl=128 shim=input::setSoundThreshold
     function setSoundThreshold(sound: SoundThreshold, threshold?: int32): void;
+
+    /**
+     * Streams raw samples from the microphone in the background, in blocks of signed 8 or
+     * 16-bit little endian samples.
+     * @param sampleRate samples per second, eg: 11000
+     * @param samplesPerBlock number of samples in each block, eg: 256
+     * @param format the size of each sample
+     */
+    //% parts="microphone" advanced=true
+    //% group="micro:bit (V2)" format.defl=2 shim=input::startMicrophoneStream
+    function startMicrophoneStream(sampleRate: int32, samplesPerBlock: int32, format?: MicrophoneSampleFormat): void;
+
+    /**
+     * Stops the microphone stream.
+     */
+    //% parts="microphone" advanced=true
+    //% group="micro:bit (V2)" shim=input::stopMicrophoneStream
+    function stopMicrophoneStream(): void;
+
+    /**
+     * Takes the oldest full block of samples from the microphone stream.
+     * @returns null if no block is available
+     */
+    //% parts="microphone" advanced=true
+    //% group="micro:bit (V2)" shim=input::readMicrophoneBlock
+    function readMicrophoneBlock(): Buffer;
+
+    /**
+     * Runs code each time a block of microphone samples is ready.
+     * @param handler code to run, typically calling ``readMicrophoneBlock``
+     */
+    //% parts="microphone" advanced=true
+    //% group="micro:bit (V2)" shim=input::onMicrophoneBlock
+    function onMicrophoneBlock(handler: () => void): void;
+
+    /**
+     * Gets the number of microphone samples dropped because no block was free.
+     */
+    //% parts="microphone" advanced=true
+    //% group="micro:bit (V2)" shim=input::microphoneStreamOverruns
+    function microphoneStreamOverruns(): int32;
+
+    /**
+     * Runs code when a clap, or the start or end of someone speaking, is heard.
+     * @param activity the kind of sound to listen for
+     * @param handler code to run
+     */
+    //% parts="microphone" advanced=true
+    //% group="micro:bit (V2)" shim=input::onSoundActivity
+    function onSoundActivity(activity: SoundActivity, handler: () => void): void;
+
+    /**
+     * Sets how easily claps or voices are detected. Voice start and end share a sensitivity.
+     * @param activity the kind of sound to configure
+     * @param sensitivity from 0 (only very loud sounds) to 255 (the faintest sounds), eg: 128
+     */
+    //% parts="microphone" advanced=true
+    //% group="micro:bit (V2)" shim=input::setSoundActivitySensitivity
+    function setSoundActivitySensitivity(activity: SoundActivity, sensitivity: int32): void;
+
+    /**
+     * Tells whether someone is speaking, as heard by the voice detector.
+     */
+    //% parts="microphone" advanced=true
+    //% group="micro:bit (V2)" shim=input::isVoiceActive
+    function isVoiceActive(): boolean;
 }
 
 // Auto-generated. Do not edit. Really.
@@ -0,0 +1,247 @@
+namespace radio {
+    // frame type of the mesh; see README.md for the layout
+    export const MESH_DATA = 34
+
+    const MESH_HEADER_SIZE = 14
+    const FRAME_SIZE = 32
+    /**
+     * Largest payload carried by one mesh message.
+     */
+    export const MESH_MAX_PAYLOAD = FRAME_SIZE - MESH_HEADER_SIZE
+
+    class MeshForward {
+        frame: Buffer
+        due: number
+
+        constructor(frame: Buffer, due: number) {
+            this.frame = frame
+            this.due = due
+        }
+    }
+
+    /**
+     * Floods messages across devices out of range of each other. Every device repeats what
+     * it hears, once, after a random delay so that neighbours do not all transmit together,
+     * until the message has made its number of hops. A message is known by its origin and
+     * the origin's sequence number; the ones seen recently are remembered so that each is
+     * delivered and repeated only once.
+     *
+     * Frames go out through a function, and time comes from a clock function, so the same
+     * code runs on the radio and against a simulated network.
+     */
+    export class MeshNode {
+        serial: number
+        sendFrame: (frame: Buffer) => void
+        now: () => number
+        random: (max: number) => number
+        seq: number
+
+        // hops a message makes by default, up to 255
+        ttl: number
+        // milliseconds a repeat waits, picked between the two
+        minDelay: number
+        maxDelay: number
+
+        // messages seen recently, least recently seen first
+        cacheSize: number
+        cacheOrigin: number[]
+        cacheSeq: number[]
+        forwards: MeshForward[]
+
+        onReceive: (origin: number, payload: Buffer, hops: number) => void
+
+        // messages sent from here, repeated for others, delivered here, heard again,
+        // and not repeated because they made all their hops
+        sent: number
+        forwarded: number
+        delivered: number
+        duplicates: number
+        expired: number
+        // hops made by the last message delivered, and by all of them together
+        lastHops: number
+        totalHops: number
+
+        constructor(serial: number, sendFrame: (frame: Buffer) => void, now: () => number) {
+            this.serial = serial
+            this.sendFrame = sendFrame
+            this.now = now
+            this.random = max => Math.randomRange(0, max)
+            this.seq = Math.randomRange(0, 0xffff)
+            this.ttl = 4
+            this.minDelay = 5
+            this.maxDelay = 50
+            this.cacheSize = 32
+            this.cacheOrigin = []
+            this.cacheSeq = []
+            this.forwards = []
+            this.onReceive = null
+            this.sent = 0
+            this.forwarded = 0
+            this.delivered = 0
+            this.duplicates = 0
+            this.expired = 0
+            this.lastHops = 0
+            this.totalHops = 0
+        }
+
+        // tells whether a message was seen recently, and remembers it as the most recent one
+        private seen(origin: number, seq: number): boolean {
+            for (let i = 0; i < this.cacheOrigin.length; ++i) {
+                if (this.cacheOrigin[i] == origin && this.cacheSeq[i] == seq) {
+                    this.cacheOrigin.removeAt(i)
+                    this.cacheSeq.removeAt(i)
+                    this.cacheOrigin.push(origin)
+                    this.cacheSeq.push(seq)
+                    return true
+                }
+            }
+            while (this.cacheOrigin.length >= Math.max(1, this.cacheSize)) {
+                this.cacheOrigin.removeAt(0)
+                this.cacheSeq.removeAt(0)
+            }
+            this.cacheOrigin.push(origin)
+            this.cacheSeq.push(seq)
+            return false
+        }
+
+        /**
+         * Sends a message across the mesh. Payloads longer than MESH_MAX_PAYLOAD are cut.
+         * @param destination serial number of the only device to deliver to, or 0 for all of them
+         * @param ttl hops the message makes, or 0 for the default
+         */
+        send(payload: Buffer, destination: number, ttl: number) {
+            const len = Math.min(payload.length, MESH_MAX_PAYLOAD)
+            this.seq = (this.seq + 1) & 0xffff
+            const frame = pins.createBuffer(MESH_HEADER_SIZE + len)
+            frame[0] = MESH_DATA
+            frame.setNumber(NumberFormat.Int32LE, 1, this.serial)
+            frame.setNumber(NumberFormat.Int32LE, 5, destination)
+            frame.setNumber(NumberFormat.UInt16LE, 9, this.seq)
+            frame[11] = Math.clamp(1, 255, ttl || this.ttl)
+            frame[12] = 0
+            frame[13] = len
+            frame.write(MESH_HEADER_SIZE, payload.slice(0, len))
+            this.seen(this.serial, this.seq)
+            this.sent++
+            this.sendFrame(frame)
+        }
+
+        /**
+         * Handles a frame heard from a neighbour.
+         */
+        receive(frame: Buffer) {
+            if (!frame || frame.length < MESH_HEADER_SIZE || frame[0] != MESH_DATA)
+                return
+            const origin = frame.getNumber(NumberFormat.Int32LE, 1)
+            const destination = frame.getNumber(NumberFormat.Int32LE, 5)
+            if (this.seen(origin, frame.getNumber(NumberFormat.UInt16LE, 9))) {
+                this.duplicates++
+                return
+            }
+
+            const ttl = frame[11]
+            const hops = frame[12] + 1
+            if (destination == 0 || destination == this.serial) {
+                // frames from the radio carry the RSSI after the 32 bytes of the frame
+                const len = Math.min(frame[13], Math.min(MESH_MAX_PAYLOAD, frame.length - MESH_HEADER_SIZE))
+                this.delivered++
+                this.lastHops = hops
+                this.totalHops += hops
+                if (this.onReceive)
+                    this.onReceive(origin, frame.slice(MESH_HEADER_SIZE, len), hops)
+            }
+            if (destination == this.serial)
+                return
+            if (hops >= ttl) {
+                this.expired++
+                return
+            }
+
+            const forward = frame.slice(0, MESH_HEADER_SIZE + Math.min(frame[13], MESH_MAX_PAYLOAD))
+            forward[12] = hops
+            const wait = this.minDelay + this.random(Math.max(0, this.maxDelay - this.minDelay))
+            this.forwards.push(new MeshForward(forward, this.now() + wait))
+        }
+
+        /**
+         * Sends the repeats that are due. Call it regularly.
+         */
+        tick() {
+            const now = this.now()
+            for (let i = 0; i < this.forwards.length;) {
+                const f = this.forwards[i]
+                if (now - f.due < 0) {
+                    i++
+                    continue
+                }
+                this.forwards.removeAt(i)
+                this.forwarded++
+                this.sendFrame(f.frame)
+            }
+        }
+    }
+
+    const MESH_TICK = 5
+    let mesh: MeshNode
+
+    function receiveMesh() {
+        let frame = radio.readProtocolPacket(MESH_DATA)
+        while (frame) {
+            mesh.receive(frame)
+            frame = radio.readProtocolPacket(MESH_DATA)
+        }
+    }
+
+    /**
+     * Gets the mesh node of this device, starting it on first use. Once started, the device
+     * repeats the mesh messages it hears.
+     */
+    //% advanced=true
+    export function meshNode(): MeshNode {
+        if (!mesh) {
+            mesh = new MeshNode(control.deviceSerialNumber(), function (frame: Buffer) {
+                radio.sendProtocolPacket(frame)
+            }, () => control.millis())
+            radio.onProtocolPacket(MESH_DATA, receiveMesh)
+            control.runInParallel(function () {
+                while (true) {
+                    mesh.tick()
+                    basic.pause(MESH_TICK)
+                }
+            })
+        }
+        return mesh
+    }
+
+    /**
+     * Sends a message to every device of the mesh, through the devices in between.
+     * @param payload up to 18 bytes
+     * @param destination serial number of the only device to deliver to, or 0 for all of them, eg: 0
+     */
+    //% advanced=true
+    export function sendMesh(payload: Buffer, destination = 0) {
+        meshNode().send(payload, destination, 0)
+    }
+
+    /**
+     * Runs some code when a mesh message arrives.
+     */
+    //% advanced=true
+    export function onMeshReceived(handler: (origin: number, payload: Buffer, hops: number) => void) {
+        meshNode().onReceive = handler
+    }
+
+    /**
+     * Sets how far mesh messages go and how long repeats wait.
+     * @param ttl hops a message makes, 1 to 255, eg: 4
+     * @param minDelay shortest wait before repeating a message, in milliseconds, eg: 5
+     * @param maxDelay longest wait before repeating a message, in milliseconds, eg: 50
+     */
+    //% advanced=true
+    export function setMeshOptions(ttl: number, minDelay: number, maxDelay: number) {
+        const m = meshNode()
+        m.ttl = Math.clamp(1, 255, ttl)
+        m.minDelay = Math.max(0, minDelay)
+        m.maxDelay = Math.max(m.minDelay, maxDelay)
+    }
+}
@@ -0,0 +1,225 @@
+// Runs mesh nodes on a simulated network where each node only hears its neighbours, frames
+// can be lost, and frames reaching a node at the same time collide.
+const rand = new Math.FastRandom(5)
+
+let clock = 0
+
+class MeshNetwork {
+    nodes: radio.MeshNode[]
+    neighbours: number[][]
+    // percentage of frames lost on each link
+    loss: number
+    collisions: number
+    // frames sent during the current millisecond, heard during the next one
+    frames: Buffer[]
+    senders: number[]
+
+    constructor(size: number, loss: number) {
+        this.nodes = []
+        this.neighbours = []
+        this.loss = loss
+        this.collisions = 0
+        this.frames = []
+        this.senders = []
+        for (let i = 0; i < size; ++i) {
+            const node = new radio.MeshNode(0x100 + i, f => this.transmit(i, f), () => clock)
+            node.random = max => rand.randomRange(0, max)
+            this.nodes.push(node)
+            this.neighbours.push([])
+        }
+    }
+
+    link(a: number, b: number) {
+        this.neighbours[a].push(b)
+        this.neighbours[b].push(a)
+    }
+
+    transmit(sender: number, frame: Buffer) {
+        this.frames.push(frame)
+        this.senders.push(sender)
+    }
+
+    step() {
+        clock++
+        const frames = this.frames
+        const senders = this.senders
+        this.frames = []
+        this.senders = []
+        for (let r = 0; r < this.nodes.length; ++r) {
+            const heard: Buffer[] = []
+            for (let i = 0; i < frames.length; ++i)
+                if (this.neighbours[r].indexOf(senders[i]) >= 0)
+                    heard.push(frames[i])
+            if (heard.length > 1) {
+                this.collisions++
+                continue
+            }
+            if (heard.length == 1 && rand.randomRange(0, 99) >= this.loss)
+                this.nodes[r].receive(heard[0])
+        }
+        for (const node of this.nodes)
+            node.tick()
+    }
+
+    run(ms: number) {
+        for (let i = 0; i < ms; ++i)
+            this.step()
+    }
+}
+
+function line(size: number) {
+    const net = new MeshNetwork(size, 0)
+    for (let i = 1; i < size; ++i)
+        net.link(i - 1, i)
+    return net
+}
+
+function grid(side: number, loss: number) {
+    const net = new MeshNetwork(side * side, loss)
+    for (let y = 0; y < side; ++y)
+        for (let x = 0; x < side; ++x) {
+            if (x > 0) net.link(y * side + x - 1, y * side + x)
+            if (y > 0) net.link((y - 1) * side + x, y * side + x)
+        }
+    return net
+}
+
+function message(i: number) {
+    const buf = pins.createBuffer(2)
+    buf.setNumber(NumberFormat.UInt16LE, 0, i)
+    return buf
+}
+
+// along a line, each node gets the message once, one hop further than its neighbour
+function testLine() {
+    const net = line(6)
+    const hops: number[] = []
+    for (let i = 0; i < 6; ++i)
+        hops.push(-1)
+    for (let i = 1; i < 6; ++i) {
+        const k = i
+        net.nodes[i].onReceive = function (origin: number, payload: Buffer, h: number) {
+            control.assert(origin == 0x100, "origin")
+            control.assert(payload.getNumber(NumberFormat.UInt16LE, 0) == 42, "payload")
+            control.assert(hops[k] < 0, "delivered once")
+            hops[k] = h
+        }
+    }
+    net.nodes[0].send(message(42), 0, 5)
+    net.run(500)
+    for (let i = 1; i < 6; ++i) {
+        control.assert(hops[i] == i, "hops " + i)
+        control.assert(net.nodes[i].delivered == 1, "delivered " + i)
+    }
+    control.assert(net.nodes[5].lastHops == 5, "last hops")
+    // every node but the last repeats it once, and hears it back from the next one
+    control.assert(net.nodes[2].forwarded == 1, "forwarded")
+    control.assert(net.nodes[2].duplicates == 1, "heard back")
+    control.assert(net.nodes[5].expired == 1, "expired at the end")
+}
+
+// the message stops after its number of hops
+function testTtl() {
+    const net = line(6)
+    net.nodes[0].send(message(1), 0, 2)
+    net.run(500)
+    control.assert(net.nodes[1].delivered == 1, "first hop")
+    control.assert(net.nodes[2].delivered == 1, "second hop")
+    control.assert(net.nodes[2].expired == 1, "expired after ttl")
+    control.assert(net.nodes[2].forwarded == 0, "not forwarded after ttl")
+    control.assert(net.nodes[3].delivered == 0, "stopped after ttl")
+}
+
+// every node of a lossy grid floods a message to all the others
+function floodGrid(minDelay: number, maxDelay: number) {
+    const net = grid(4, 10)
+    for (const node of net.nodes) {
+        node.minDelay = minDelay
+        node.maxDelay = maxDelay
+        node.ttl = 8
+    }
+    for (let i = 0; i < net.nodes.length; ++i) {
+        net.nodes[i].send(message(i), 0, 0)
+        net.run(300)
+    }
+    return net
+}
+
+function testGrid() {
+    const net = floodGrid(2, 40)
+    let delivered = 0
+    for (const node of net.nodes) {
+        control.assert(node.delivered <= 15, "delivered once each")
+        control.assert(node.sent == 1, "sent")
+        control.assert(node.duplicates > 0, "heard again")
+        control.assert(node.totalHops >= node.delivered, "hops")
+        delivered += node.delivered
+    }
+    // a message is gone when its first transmission is lost on all the links of its origin
+    control.assert(delivered >= 16 * 15 * 90 / 100, "delivery rate")
+    // repeating at once makes neighbours transmit together
+    const storm = floodGrid(0, 0)
+    control.assert(storm.collisions > net.collisions, "collisions without delay")
+}
+
+// a message for one device is delivered there only, repeated by the others on the way,
+// and not repeated any further
+function testDestination() {
+    const net = line(5)
+    const target = net.nodes[3]
+    net.nodes[0].send(message(7), target.serial, 0)
+    net.run(500)
+    control.assert(target.delivered == 1, "delivered to destination")
+    control.assert(target.lastHops == 3, "hops to destination")
+    control.assert(target.forwarded == 0, "not forwarded by destination")
+    for (let i = 1; i < 3; ++i) {
+        control.assert(net.nodes[i].delivered == 0, "not delivered on the way")
+        control.assert(net.nodes[i].forwarded == 1, "forwarded on the way")
+    }
+    control.assert(net.nodes[4].delivered + net.nodes[4].duplicates == 0, "not past destination")
+}
+
+// only the most recently seen messages are remembered
+function testCache() {
+    const frames: Buffer[] = []
+    const origin = new radio.MeshNode(0x200, f => frames.push(f), () => clock)
+    for (let i = 0; i < 3; ++i)
+        origin.send(message(i), 0, 1)
+    const node = new radio.MeshNode(0x201, f => { }, () => clock)
+    node.cacheSize = 2
+    node.receive(frames[0])
+    node.receive(frames[1])
+    node.receive(frames[0])
+    control.assert(node.delivered == 2 && node.duplicates == 1, "cache hit")
+    // the first message was seen last, so the second one is forgotten
+    node.receive(frames[2])
+    node.receive(frames[0])
+    control.assert(node.duplicates == 2, "least recent forgotten")
+    node.receive(frames[1])
+    control.assert(node.delivered == 4, "forgotten delivered again")
+}
+
+// buffers from the radio are padded to 36 bytes, the last 4 holding the RSSI; a bad length
+// byte must not deliver them as payload
+function testLength() {
+    const frames: Buffer[] = []
+    const origin = new radio.MeshNode(0x300, f => frames.push(f), () => clock)
+    origin.send(message(0), 0, 1)
+    const raw = pins.createBuffer(36)
+    raw.write(0, frames[0])
+    raw[13] = 0xff
+    const node = new radio.MeshNode(0x301, f => { }, () => clock)
+    let length = -1
+    node.onReceive = function (origin: number, payload: Buffer, hops: number) {
+        length = payload.length
+    }
+    node.receive(raw)
+    control.assert(length == radio.MESH_MAX_PAYLOAD, "payload clamped to the frame")
+}
+
+testLine()
+testTtl()
+testGrid()
+testDestination()
+testCache()
+testLength()
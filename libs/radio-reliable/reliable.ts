@@ -0,0 +1,374 @@
+namespace radio {
+    // frame types of the reliable transport; see README.md for the layout
+    export const RELIABLE_DATA = 32
+    export const RELIABLE_ACK = 33
+
+    const DATA_HEADER_SIZE = 15
+    const ACK_SIZE = 15
+    const FRAME_SIZE = 32
+    // most messages on their way at once, as many as an acknowledgment can report
+    const MAX_WINDOW = 16
+    /**
+     * Largest payload carried by one reliable message.
+     */
+    export const RELIABLE_MAX_PAYLOAD = FRAME_SIZE - DATA_HEADER_SIZE
+
+    // sequence numbers are 16 bits and wrap around; a - b, between -32768 and 32767
+    function seqDiff(a: number, b: number) {
+        const d = (a - b) & 0xffff
+        return d >= 0x8000 ? d - 0x10000 : d
+    }
+
+    class InFlight {
+        payload: Buffer
+        seq: number
+        deadline: number
+        retries: number
+        acked: boolean
+
+        constructor(payload: Buffer, seq: number) {
+            this.payload = payload
+            this.seq = seq
+            this.deadline = 0
+            this.retries = 0
+            this.acked = false
+        }
+    }
+
+    /**
+     * What one device knows about a peer: the messages on their way to it, and the ones
+     * received from it that are waiting for an earlier one.
+     */
+    class ReliablePeer {
+        serial: number
+        // sending
+        base: number
+        inFlight: InFlight[]
+        queued: Buffer[]
+        // receiving; the session changes when the peer restarts
+        session: number
+        expected: number
+        // slot i holds the message expected + i
+        received: Buffer[]
+
+        constructor(serial: number, firstSeq: number) {
+            this.serial = serial
+            this.base = firstSeq
+            this.inFlight = []
+            this.queued = []
+            this.session = -1
+            this.expected = 0
+            this.received = []
+        }
+    }
+
+    /**
+     * Reliable unicast over a lossy broadcast medium. Every message carries a sequence number
+     * and is repeated until the peer acknowledges it; acknowledgments are selective, so only
+     * missing messages are repeated. Messages are delivered once each, in order.
+     *
+     * Frames go out through a function, and time comes from a clock function, so the same
+     * code runs on the radio and against a simulated medium.
+     */
+    export class ReliableTransport {
+        serial: number
+        sendFrame: (frame: Buffer) => void
+        now: () => number
+        peers: ReliablePeer[]
+        session: number
+        firstSeq: number
+
+        // messages sent but not acknowledged at once, up to MAX_WINDOW
+        window: number
+        // milliseconds before the first repeat; each repeat waits twice as long
+        timeout: number
+        // repeats before a message is given up
+        maxRetries: number
+
+        onReceive: (serial: number, payload: Buffer) => void
+        onFailure: (serial: number, payload: Buffer) => void
+
+        // messages delivered to the program, frames sent for the first time and again,
+        // duplicates dropped, frames dropped for being too far ahead, and messages given up
+        delivered: number
+        sent: number
+        retransmitted: number
+        duplicates: number
+        outOfWindow: number
+        failed: number
+
+        constructor(serial: number, sendFrame: (frame: Buffer) => void, now: () => number) {
+            this.serial = serial
+            this.sendFrame = sendFrame
+            this.now = now
+            this.peers = []
+            this.session = Math.randomRange(0, 0xff)
+            this.firstSeq = Math.randomRange(0, 0xffff)
+            this.window = 8
+            this.timeout = 100
+            this.maxRetries = 8
+            this.onReceive = null
+            this.onFailure = null
+            this.delivered = 0
+            this.sent = 0
+            this.retransmitted = 0
+            this.duplicates = 0
+            this.outOfWindow = 0
+            this.failed = 0
+        }
+
+        private peer(serial: number): ReliablePeer {
+            for (const p of this.peers)
+                if (p.serial == serial)
+                    return p
+            const p = new ReliablePeer(serial, this.firstSeq)
+            this.peers.push(p)
+            return p
+        }
+
+        /**
+         * Queues a message for a peer. Payloads longer than RELIABLE_MAX_PAYLOAD are cut.
+         */
+        send(serial: number, payload: Buffer) {
+            const p = this.peer(serial)
+            p.queued.push(payload.length > RELIABLE_MAX_PAYLOAD ? payload.slice(0, RELIABLE_MAX_PAYLOAD) : payload)
+            this.fill(p)
+        }
+
+        /**
+         * Number of messages to a peer that are not acknowledged yet.
+         */
+        pending(serial: number): number {
+            const p = this.peer(serial)
+            return p.inFlight.length + p.queued.length
+        }
+
+        private fill(p: ReliablePeer) {
+            const window = Math.clamp(1, MAX_WINDOW, this.window)
+            while (p.inFlight.length < window && p.queued.length) {
+                const m = new InFlight(p.queued.shift(), (p.base + p.inFlight.length) & 0xffff)
+                p.inFlight.push(m)
+                this.transmit(p, m)
+                this.sent++
+            }
+        }
+
+        private transmit(p: ReliablePeer, m: InFlight) {
+            const frame = pins.createBuffer(DATA_HEADER_SIZE + m.payload.length)
+            frame[0] = RELIABLE_DATA
+            frame.setNumber(NumberFormat.Int32LE, 1, this.serial)
+            frame.setNumber(NumberFormat.Int32LE, 5, p.serial)
+            frame[9] = this.session
+            frame.setNumber(NumberFormat.UInt16LE, 10, m.seq)
+            // the oldest message still on its way, so the peer can skip any we gave up
+            frame.setNumber(NumberFormat.UInt16LE, 12, p.base)
+            frame[14] = m.payload.length
+            frame.write(DATA_HEADER_SIZE, m.payload)
+            m.deadline = this.now() + (this.timeout << Math.min(m.retries, 6))
+            this.sendFrame(frame)
+        }
+
+        private acknowledge(p: ReliablePeer) {
+            // bit i stands for the message expected + 1 + i
+            let bits = 0
+            for (let i = 1; i < p.received.length; ++i)
+                if (p.received[i])
+                    bits |= 1 << (i - 1)
+            const frame = pins.createBuffer(ACK_SIZE)
+            frame[0] = RELIABLE_ACK
+            frame.setNumber(NumberFormat.Int32LE, 1, this.serial)
+            frame.setNumber(NumberFormat.Int32LE, 5, p.serial)
+            frame.setNumber(NumberFormat.UInt16LE, 9, p.expected)
+            frame.setNumber(NumberFormat.Int32LE, 11, bits)
+            this.sendFrame(frame)
+        }
+
+        /**
+         * Handles a frame from the medium; frames for other devices are ignored.
+         */
+        receive(frame: Buffer) {
+            if (!frame || frame.length < DATA_HEADER_SIZE)
+                return
+            if (frame.getNumber(NumberFormat.Int32LE, 5) != this.serial)
+                return
+            const p = this.peer(frame.getNumber(NumberFormat.Int32LE, 1))
+            if (frame[0] == RELIABLE_DATA)
+                this.receiveData(p, frame)
+            else if (frame[0] == RELIABLE_ACK)
+                this.receiveAck(p, frame)
+        }
+
+        private deliver(p: ReliablePeer, payload: Buffer) {
+            this.delivered++
+            if (this.onReceive)
+                this.onReceive(p.serial, payload)
+        }
+
+        // delivers the messages in order from slot 0, skipping the missing ones before upTo
+        private advance(p: ReliablePeer, upTo: number) {
+            while (p.received.length && (p.received[0] || seqDiff(upTo, p.expected) > 0)) {
+                const payload = p.received.shift()
+                p.expected = (p.expected + 1) & 0xffff
+                if (payload)
+                    this.deliver(p, payload)
+            }
+            if (seqDiff(upTo, p.expected) > 0)
+                p.expected = upTo
+        }
+
+        private receiveData(p: ReliablePeer, frame: Buffer) {
+            const session = frame[9]
+            const seq = frame.getNumber(NumberFormat.UInt16LE, 10)
+            const base = frame.getNumber(NumberFormat.UInt16LE, 12)
+            // frames from the radio carry the RSSI after the 32 bytes of the frame
+            const len = Math.min(frame[14], Math.min(RELIABLE_MAX_PAYLOAD, frame.length - DATA_HEADER_SIZE))
+
+            // the sender is new to us, or restarted
+            if (session != p.session) {
+                p.session = session
+                p.expected = base
+                p.received = []
+            }
+            // the sender gave up on messages before its base
+            this.advance(p, base)
+
+            // the sender's window may be larger than ours, so take anything up to the most
+            // a sender may have on its way
+            const slot = seqDiff(seq, p.expected)
+            if (slot < 0 || p.received[slot]) {
+                this.duplicates++
+            } else if (slot >= MAX_WINDOW) {
+                this.outOfWindow++
+            } else {
+                while (p.received.length <= slot)
+                    p.received.push(null)
+                p.received[slot] = frame.slice(DATA_HEADER_SIZE, len)
+                this.advance(p, p.expected)
+            }
+            this.acknowledge(p)
+        }
+
+        private receiveAck(p: ReliablePeer, frame: Buffer) {
+            if (frame.length < ACK_SIZE)
+                return
+            const next = frame.getNumber(NumberFormat.UInt16LE, 9)
+            const bits = frame.getNumber(NumberFormat.Int32LE, 11)
+            const acked = seqDiff(next, p.base)
+            // stale, or about messages we never sent
+            if (acked < 0 || acked > p.inFlight.length)
+                return
+            for (let i = 0; i < p.inFlight.length; ++i) {
+                const k = i - acked - 1
+                if (i < acked || (k >= 0 && k < 32 && (bits >> k) & 1))
+                    p.inFlight[i].acked = true
+            }
+            while (p.inFlight.length && p.inFlight[0].acked) {
+                p.inFlight.shift()
+                p.base = (p.base + 1) & 0xffff
+            }
+            this.fill(p)
+        }
+
+        /**
+         * Repeats the messages whose acknowledgment is late. Call it regularly.
+         */
+        tick() {
+            const now = this.now()
+            for (const p of this.peers) {
+                for (const m of p.inFlight) {
+                    if (m.acked || now - m.deadline < 0)
+                        continue
+                    if (m.retries >= this.maxRetries) {
+                        m.acked = true
+                        this.failed++
+                        if (this.onFailure)
+                            this.onFailure(p.serial, m.payload)
+                        continue
+                    }
+                    m.retries++
+                    this.retransmitted++
+                    this.transmit(p, m)
+                }
+                while (p.inFlight.length && p.inFlight[0].acked) {
+                    p.inFlight.shift()
+                    p.base = (p.base + 1) & 0xffff
+                }
+                this.fill(p)
+            }
+        }
+    }
+
+    const RELIABLE_TICK = 20
+    let reliable: ReliableTransport
+
+    function receiveReliable(type: number) {
+        let frame = radio.readProtocolPacket(type)
+        while (frame) {
+            reliable.receive(frame)
+            frame = radio.readProtocolPacket(type)
+        }
+    }
+
+    /**
+     * Gets the reliable transport of this device, starting it on first use.
+     */
+    //% advanced=true
+    export function reliableTransport(): ReliableTransport {
+        if (!reliable) {
+            reliable = new ReliableTransport(control.deviceSerialNumber(), function (frame: Buffer) {
+                radio.sendProtocolPacket(frame)
+            }, () => control.millis())
+            radio.onProtocolPacket(RELIABLE_DATA, () => receiveReliable(RELIABLE_DATA))
+            radio.onProtocolPacket(RELIABLE_ACK, () => receiveReliable(RELIABLE_ACK))
+            control.runInParallel(function () {
+                while (true) {
+                    reliable.tick()
+                    basic.pause(RELIABLE_TICK)
+                }
+            })
+        }
+        return reliable
+    }
+
+    /**
+     * Sends a message to one device, repeating it until the device acknowledges it.
+     * Messages to the same device arrive once each and in order.
+     * @param serial the serial number of the receiving device, as in ``receivedPacket(RadioPacketProperty.SerialNumber)``
+     * @param payload up to 17 bytes
+     */
+    //% advanced=true
+    export function sendReliable(serial: number, payload: Buffer) {
+        reliableTransport().send(serial, payload)
+    }
+
+    /**
+     * Runs some code when a message sent with ``sendReliable`` arrives.
+     */
+    //% advanced=true
+    export function onReliableReceived(handler: (serial: number, payload: Buffer) => void) {
+        reliableTransport().onReceive = handler
+    }
+
+    /**
+     * Runs some code when a message sent with ``sendReliable`` is given up, because the
+     * receiving device did not acknowledge it.
+     */
+    //% advanced=true
+    export function onReliableFailed(handler: (serial: number, payload: Buffer) => void) {
+        reliableTransport().onFailure = handler
+    }
+
+    /**
+     * Sets how messages sent with ``sendReliable`` are repeated.
+     * @param window messages on their way at once, 1 to 16, eg: 8
+     * @param timeout milliseconds before the first repeat, doubling for each next one, eg: 100
+     * @param retries repeats before a message is given up, eg: 8
+     */
+    //% advanced=true
+    export function setReliableTiming(window: number, timeout: number, retries: number) {
+        const t = reliableTransport()
+        t.window = Math.clamp(1, MAX_WINDOW, window)
+        t.timeout = Math.max(1, timeout)
+        t.maxRetries = Math.max(0, retries)
+    }
+}
@@ -0,0 +1,214 @@
+// Runs reliable transports against a simulated medium that loses and delays frames, on a
+// simulated clock, and checks that messages arrive once each and in order.
+const rand = new Math.FastRandom(11)
+
+let clock = 0
+
+class LossyMedium {
+    // percentage of frames lost
+    loss: number
+    // milliseconds a frame takes, plus up to jitter more
+    latency: number
+    jitter: number
+    frames: Buffer[]
+    due: number[]
+    nodes: radio.ReliableTransport[]
+
+    constructor(loss: number, latency: number, jitter: number) {
+        this.loss = loss
+        this.latency = latency
+        this.jitter = jitter
+        this.frames = []
+        this.due = []
+        this.nodes = []
+    }
+
+    send(frame: Buffer) {
+        if (rand.randomRange(0, 99) < this.loss)
+            return
+        this.frames.push(frame)
+        this.due.push(clock + this.latency + rand.randomRange(0, this.jitter))
+    }
+
+    step() {
+        const arrived: Buffer[] = []
+        for (let i = 0; i < this.frames.length;) {
+            if (this.due[i] <= clock) {
+                arrived.push(this.frames[i])
+                this.frames.removeAt(i)
+                this.due.removeAt(i)
+            } else {
+                i++
+            }
+        }
+        // every node hears every frame, as on the radio
+        for (const frame of arrived)
+            for (const node of this.nodes)
+                node.receive(frame)
+    }
+}
+
+const SENDER = 0x1001
+const RECEIVER = 0x2002
+
+function message(i: number) {
+    const buf = pins.createBuffer(2 + i % 16)
+    buf.setNumber(NumberFormat.UInt16LE, 0, i)
+    return buf
+}
+
+function runUntilIdle(medium: LossyMedium, sender: radio.ReliableTransport, serial: number) {
+    const end = clock + 120000
+    while ((sender.pending(serial) || medium.frames.length) && clock < end) {
+        clock += 5
+        medium.step()
+        for (const node of medium.nodes)
+            node.tick()
+    }
+}
+
+function transfer(loss: number, latency: number, jitter: number, count: number) {
+    const medium = new LossyMedium(loss, latency, jitter)
+    const a = new radio.ReliableTransport(SENDER, f => medium.send(f), () => clock)
+    const b = new radio.ReliableTransport(RECEIVER, f => medium.send(f), () => clock)
+    medium.nodes = [a, b]
+    // a message whose every try loses its data or acknowledgment is not what is tested here
+    a.maxRetries = 16
+    const received: number[] = []
+    b.onReceive = function (serial: number, payload: Buffer) {
+        control.assert(serial == SENDER, "sender")
+        control.assert(payload.length == 2 + received.length % 16, "payload length")
+        received.push(payload.getNumber(NumberFormat.UInt16LE, 0))
+    }
+    for (let i = 0; i < count; ++i)
+        a.send(RECEIVER, message(i))
+    runUntilIdle(medium, a, RECEIVER)
+
+    control.assert(a.failed == 0, "none given up")
+    control.assert(received.length == count, "received count")
+    for (let i = 0; i < count; ++i)
+        control.assert(received[i] == i, "in order " + i)
+    return [a, b]
+}
+
+// a clean medium needs no repeats
+let nodes = transfer(0, 10, 0, 40)
+control.assert(nodes[0].retransmitted == 0, "no repeats")
+control.assert(nodes[1].duplicates == 0, "no duplicates")
+
+// lost data and lost acknowledgments are repeated, and the duplicates dropped
+nodes = transfer(30, 20, 15, 200)
+control.assert(nodes[0].retransmitted > 0, "repeats")
+control.assert(nodes[1].duplicates > 0, "duplicates")
+control.assert(nodes[1].delivered == 200, "delivered once each")
+
+// a small window over a slow medium still gets there
+nodes = transfer(10, 80, 40, 30)
+
+// messages to a device that never answers are given up and reported
+function testGiveUp() {
+    const medium = new LossyMedium(0, 10, 0)
+    const a = new radio.ReliableTransport(SENDER, f => medium.send(f), () => clock)
+    medium.nodes = [a]
+    a.timeout = 20
+    a.maxRetries = 3
+    let failures = 0
+    a.onFailure = function (serial: number, payload: Buffer) {
+        control.assert(serial == RECEIVER, "failure peer")
+        failures++
+    }
+    for (let i = 0; i < 12; ++i)
+        a.send(RECEIVER, message(i))
+    runUntilIdle(medium, a, RECEIVER)
+    control.assert(failures == 12, "failures reported")
+    control.assert(a.failed == 12, "failures counted")
+    control.assert(a.retransmitted == 36, "repeats before giving up")
+}
+
+// after an outage the receiver skips the messages given up and carries on
+function testOutage() {
+    const medium = new LossyMedium(0, 10, 0)
+    const a = new radio.ReliableTransport(SENDER, f => medium.send(f), () => clock)
+    const b = new radio.ReliableTransport(RECEIVER, f => medium.send(f), () => clock)
+    medium.nodes = [a, b]
+    a.maxRetries = 2
+    const received: number[] = []
+    b.onReceive = function (serial: number, payload: Buffer) {
+        received.push(payload.getNumber(NumberFormat.UInt16LE, 0))
+    }
+    for (let i = 0; i < 5; ++i)
+        a.send(RECEIVER, message(i))
+    runUntilIdle(medium, a, RECEIVER)
+    medium.loss = 100
+    for (let i = 5; i < 10; ++i)
+        a.send(RECEIVER, message(i))
+    runUntilIdle(medium, a, RECEIVER)
+    medium.loss = 0
+    for (let i = 10; i < 15; ++i)
+        a.send(RECEIVER, message(i))
+    runUntilIdle(medium, a, RECEIVER)
+    control.assert(a.failed == 5, "given up during outage")
+    control.assert(received.length == 10, "received around outage")
+    for (let i = 0; i < 10; ++i)
+        control.assert(received[i] == (i < 5 ? i : i + 5), "skipped given up " + i)
+}
+
+// a sender with a larger window than the receiver is not held back
+function testWindows() {
+    const medium = new LossyMedium(20, 10, 10)
+    const a = new radio.ReliableTransport(SENDER, f => medium.send(f), () => clock)
+    const b = new radio.ReliableTransport(RECEIVER, f => medium.send(f), () => clock)
+    medium.nodes = [a, b]
+    a.window = 16
+    a.maxRetries = 16
+    b.window = 1
+    let count = 0
+    b.onReceive = function (serial: number, payload: Buffer) {
+        control.assert(payload.getNumber(NumberFormat.UInt16LE, 0) == count, "in order " + count)
+        count++
+    }
+    for (let i = 0; i < 100; ++i)
+        a.send(RECEIVER, message(i))
+    runUntilIdle(medium, a, RECEIVER)
+    control.assert(count == 100, "all received")
+    control.assert(b.outOfWindow == 0, "nothing out of window")
+
+    // a frame further ahead than any sender's window is dropped, and not as a duplicate
+    const frames: Buffer[] = []
+    const c = new radio.ReliableTransport(SENDER, f => frames.push(f), () => clock)
+    c.send(RECEIVER, message(0))
+    c.tick()
+    const ahead = frames[0].slice(0, frames[0].length)
+    ahead.setNumber(NumberFormat.UInt16LE, 10, (ahead.getNumber(NumberFormat.UInt16LE, 10) + 16) & 0xffff)
+    const d = new radio.ReliableTransport(RECEIVER, f => { }, () => clock)
+    d.receive(ahead)
+    d.receive(frames[0])
+    d.receive(frames[0])
+    control.assert(d.outOfWindow == 1, "out of window")
+    control.assert(d.duplicates == 1, "duplicate")
+    control.assert(d.delivered == 1, "delivered")
+}
+
+// buffers from the radio are padded to 36 bytes, the last 4 holding the RSSI; a bad length
+// byte must not deliver them as payload
+function testLength() {
+    const frames: Buffer[] = []
+    const a = new radio.ReliableTransport(SENDER, f => frames.push(f), () => clock)
+    a.send(RECEIVER, message(0))
+    a.tick()
+    const raw = pins.createBuffer(36)
+    raw.write(0, frames[0])
+    raw[14] = 0xff
+    const b = new radio.ReliableTransport(RECEIVER, f => { }, () => clock)
+    let length = -1
+    b.onReceive = function (serial: number, payload: Buffer) {
+        length = payload.length
+    }
+    b.receive(raw)
+    control.assert(length == radio.RELIABLE_MAX_PAYLOAD, "payload clamped to the frame")
+}
+
+testGiveUp()
+testOutage()
+testWindows()
+testLength()
@@ -1,4 +1,24 @@
 // Auto-generated. Do not edit.
+
+
+    declare const enum RadioStatistic {
+    //% block="frames sent"
+    FramesSent = 0,
+    //% block="bytes sent"
+    BytesSent = 1,
+    //% block="frames received"
+    FramesReceived = 2,
+    //% block="bytes received"
+    BytesReceived = 3,
+    //% block="packets sent"
+    PacketsSent = 4,
+    //% block="packets received"
+    PacketsReceived = 5,
+    //% block="frames per second"
+    FramesPerSecond = 6,
+    //% block="bytes per second"
+    BytesPerSecond = 7,
+    }
 declare namespace radio {
 }
 
@@ -0,0 +1,453 @@
+#include "pxt.h"
+
+// frames of the protocols layered on the radio, such as the reliable transport, the batches
+// that carry several of them in one frame, and their traffic counters.
+//
+// These frames go out under their own radio protocol number rather than as datagrams. The
+// radio raises MICROBIT_ID_RADIO_DATA_READY for frames of a protocol it does not know, so
+// they never reach the datagram queue that radio.ts reads, and radio.cpp stays as the
+// common packages ship it.
+//
+// The first byte of a frame is its type:
+//   0 - 15    never sent here; radio.ts uses these for its datagram packets
+//   16        a batch of frames, see RadioBatcher
+//   17 - 31   reserved for the radio library
+//   32 - 255  protocols, such as the reliable transport (32, 33) and the mesh (34)
+
+#define RADIO_RAW_PACKET_SIZE (MICROBIT_RADIO_MAX_PACKET_SIZE + sizeof(int))
+
+#ifndef RADIO_PROTOCOL_LAYERED
+#define RADIO_PROTOCOL_LAYERED 3
+#endif
+
+#define RADIO_FRAME_TYPE_BATCH 16
+#define RADIO_BATCH_COMPRESSED 0x01
+// bytes every protocol frame has after its type: sender serial, receiver serial
+#define RADIO_BATCH_SHARED_SIZE 8
+// frames of a protocol raise RADIO_PROTOCOL_EVT_ID with their type as the value
+#define RADIO_FRAME_TYPE_PROTOCOL 32
+#define RADIO_PROTOCOL_EVT_ID 9518
+
+// frames taken from the radio and not sorted yet
+#ifndef RADIO_PENDING_QUEUE_SIZE
+#define RADIO_PENDING_QUEUE_SIZE 4
+#endif
+
+#ifndef RADIO_PROTOCOL_QUEUE_SIZE
+#define RADIO_PROTOCOL_QUEUE_SIZE 8
+#endif
+
+enum class RadioStatistic {
+    //% block="frames sent"
+    FramesSent = 0,
+    //% block="bytes sent"
+    BytesSent = 1,
+    //% block="frames received"
+    FramesReceived = 2,
+    //% block="bytes received"
+    BytesReceived = 3,
+    //% block="packets sent"
+    PacketsSent = 4,
+    //% block="packets received"
+    PacketsReceived = 5,
+    //% block="frames per second"
+    FramesPerSecond = 6,
+    //% block="bytes per second"
+    BytesPerSecond = 7,
+};
+
+namespace radio {
+
+// radio.cpp
+int radioEnable();
+
+/**
+ * Frame and byte counters for the protocol frames, with on-air rates over the last full second.
+ */
+struct RadioStatistics {
+    uint32_t counters[6];
+    uint32_t windowStart;
+    uint32_t windowFrames;
+    uint32_t windowBytes;
+    uint32_t framesPerSecond;
+    uint32_t bytesPerSecond;
+
+    void update() {
+        uint32_t now = current_time_ms();
+        uint32_t elapsed = now - windowStart;
+        if (elapsed < 1000)
+            return;
+        uint32_t frames = counters[(int)RadioStatistic::FramesSent] +
+                          counters[(int)RadioStatistic::FramesReceived];
+        uint32_t bytes = counters[(int)RadioStatistic::BytesSent] +
+                         counters[(int)RadioStatistic::BytesReceived];
+        framesPerSecond = (frames - windowFrames) * 1000 / elapsed;
+        bytesPerSecond = (bytes - windowBytes) * 1000 / elapsed;
+        windowStart = now;
+        windowFrames = frames;
+        windowBytes = bytes;
+    }
+
+    void sent(int bytes) {
+        counters[(int)RadioStatistic::FramesSent]++;
+        counters[(int)RadioStatistic::BytesSent] += bytes;
+        update();
+    }
+
+    void received(int bytes) {
+        counters[(int)RadioStatistic::FramesReceived]++;
+        counters[(int)RadioStatistic::BytesReceived] += bytes;
+        update();
+    }
+};
+
+static RadioStatistics stats;
+
+/**
+ * Received protocol frames waiting to be read, each stored as a full radio frame followed by
+ * its RSSI. When the queue is full, newer frames are dropped, as the radio does with its own
+ * queue. Only used from fibers.
+ */
+template <int N> class RadioPacketQueue {
+  public:
+    uint8_t packets[N][RADIO_RAW_PACKET_SIZE];
+    int head;
+    int count;
+
+    RadioPacketQueue() : head(0), count(0) {}
+
+    bool push(const uint8_t *packet, int len, int rssi) {
+        if (count == N)
+            return false;
+        uint8_t *dst = packets[(head + count) % N];
+        memset(dst, 0, MICROBIT_RADIO_MAX_PACKET_SIZE);
+        memcpy(dst, packet, min(len, MICROBIT_RADIO_MAX_PACKET_SIZE));
+        memcpy(dst + MICROBIT_RADIO_MAX_PACKET_SIZE, &rssi, sizeof(int)); // assumes Int32LE layout
+        count++;
+        return true;
+    }
+
+    // takes the oldest packet of the given type
+    Buffer pop(int type) {
+        for (int i = 0; i < count; ++i) {
+            int k = (head + i) % N;
+            if (packets[k][0] != type)
+                continue;
+            Buffer b = mkBuffer(packets[k], RADIO_RAW_PACKET_SIZE);
+            // close the gap, keeping the order of the others
+            for (int j = i; j > 0; --j)
+                memcpy(packets[(head + j) % N], packets[(head + j - 1) % N], RADIO_RAW_PACKET_SIZE);
+            head = (head + 1) % N;
+            count--;
+            return b;
+        }
+        return NULL;
+    }
+};
+
+static RadioPacketQueue<RADIO_PROTOCOL_QUEUE_SIZE> protocolPackets;
+
+// protocol types with a handler, one bit per type; frames of other types are dropped
+static uint32_t handledTypes[8];
+
+static bool isHandled(int type) {
+    return type >= RADIO_FRAME_TYPE_PROTOCOL && (handledTypes[type >> 5] & (1u << (type & 31)));
+}
+
+static void deliver(const uint8_t *data, int len, int rssi) {
+    int type = data[0];
+    if (!isHandled(type))
+        return;
+    stats.counters[(int)RadioStatistic::PacketsReceived]++;
+    if (protocolPackets.push(data, len, rssi))
+        MicroBitEvent(RADIO_PROTOCOL_EVT_ID, type);
+}
+
+static void sendFrame(const uint8_t *data, int len) {
+    FrameBuffer buf;
+    buf.length = len + MICROBIT_RADIO_HEADER_SIZE - 1;
+    buf.version = 1;
+    buf.group = 0;
+    buf.protocol = RADIO_PROTOCOL_LAYERED;
+    memcpy(buf.payload, data, len);
+    uBit.radio.send(&buf);
+    stats.sent(len);
+}
+
+/**
+ * Packs protocol frames into shared frames, and unpacks received ones.
+ *
+ * A batch frame is the batch type, a flags byte, then the frames. Each frame is prefixed
+ * with its length. With header compression, the frames of a batch share the serial numbers
+ * after their type, which follow the flags once, and each keeps its type and the rest.
+ * Any other flags make the whole frame invalid.
+ */
+class RadioBatcher {
+  public:
+    uint8_t frame[MICROBIT_RADIO_MAX_PACKET_SIZE];
+    int length;
+    int count;
+    uint32_t deadline;
+    int latency;
+    bool compress;
+    bool flusherRunning;
+
+    RadioBatcher()
+        : length(0), count(0), deadline(0), latency(0), compress(false), flusherRunning(false) {}
+
+    int headerSize() { return compress ? 2 + RADIO_BATCH_SHARED_SIZE : 2; }
+
+    void flush() {
+        if (count == 0)
+            return;
+        if (count == 1) {
+            // not worth a batch header; send the frame as the protocol built it
+            uint8_t single[MICROBIT_RADIO_MAX_PACKET_SIZE];
+            int n = expand(frame, compress, frame + headerSize(), single);
+            sendFrame(single, n);
+        } else {
+            sendFrame(frame, length);
+        }
+        length = count = 0;
+    }
+
+    // turns a record of a batch back into a frame; returns its length
+    static int expand(const uint8_t *batch, bool compressed, const uint8_t *rec, uint8_t *dst) {
+        int n = rec[0];
+        if (!compressed) {
+            memcpy(dst, rec + 1, n);
+            return n;
+        }
+        dst[0] = rec[1];
+        memcpy(dst + 1, batch + 2, RADIO_BATCH_SHARED_SIZE);
+        memcpy(dst + 1 + RADIO_BATCH_SHARED_SIZE, rec + 2, n - 1);
+        return RADIO_BATCH_SHARED_SIZE + n;
+    }
+
+    static void flusher(void *self) {
+        RadioBatcher *b = (RadioBatcher *)self;
+        while (b->latency > 0) {
+            int wait = b->latency;
+            if (b->count) {
+                int left = (int)(b->deadline - current_time_ms());
+                if (left <= 0) {
+                    b->flush();
+                    continue;
+                }
+                wait = left;
+            }
+            fiber_sleep(wait);
+        }
+        b->flush();
+        b->flusherRunning = false;
+    }
+
+    void configure(int latency_, bool compress_) {
+        flush();
+        latency = max(0, latency_);
+        compress = compress_;
+        if (latency > 0 && !flusherRunning) {
+            flusherRunning = true;
+            create_fiber(flusher, this);
+        }
+    }
+
+    // queues a frame; returns false if it has to be sent on its own
+    bool add(const uint8_t *p, int len) {
+        if (compress && len < 1 + RADIO_BATCH_SHARED_SIZE)
+            return false;
+        int recordSize = 1 + (compress ? len - RADIO_BATCH_SHARED_SIZE : len);
+
+        if (count) {
+            bool fits = length + recordSize <= MICROBIT_RADIO_MAX_PACKET_SIZE;
+            bool sameSerials = !compress || !memcmp(frame + 2, p + 1, RADIO_BATCH_SHARED_SIZE);
+            if (!fits || !sameSerials)
+                flush();
+        }
+        if (headerSize() + recordSize > MICROBIT_RADIO_MAX_PACKET_SIZE)
+            return false;
+
+        if (count == 0) {
+            frame[0] = RADIO_FRAME_TYPE_BATCH;
+            frame[1] = compress ? RADIO_BATCH_COMPRESSED : 0;
+            if (compress)
+                memcpy(frame + 2, p + 1, RADIO_BATCH_SHARED_SIZE);
+            length = headerSize();
+            deadline = current_time_ms() + latency;
+        }
+
+        uint8_t *rec = frame + length;
+        rec[0] = recordSize - 1;
+        if (compress) {
+            rec[1] = p[0];
+            memcpy(rec + 2, p + 1 + RADIO_BATCH_SHARED_SIZE, recordSize - 2);
+        } else {
+            memcpy(rec + 1, p, recordSize - 1);
+        }
+        length += recordSize;
+        count++;
+        return true;
+    }
+
+    static void unpack(const uint8_t *data, int len, int rssi) {
+        if (len < 2 || (data[1] & ~RADIO_BATCH_COMPRESSED))
+            return;
+        bool compressed = data[1] & RADIO_BATCH_COMPRESSED;
+        int pos = compressed ? 2 + RADIO_BATCH_SHARED_SIZE : 2;
+        if (len < pos)
+            return;
+        uint8_t packet[MICROBIT_RADIO_MAX_PACKET_SIZE];
+        while (pos < len) {
+            int n = data[pos];
+            if (n == 0 || pos + 1 + n > len ||
+                (compressed ? RADIO_BATCH_SHARED_SIZE : 0) + n > MICROBIT_RADIO_MAX_PACKET_SIZE)
+                break;
+            int k = expand(data, compressed, data + pos, packet);
+            // a batch never nests
+            if (packet[0] != RADIO_FRAME_TYPE_BATCH)
+                deliver(packet, k, rssi);
+            pos += 1 + n;
+        }
+    }
+};
+
+static RadioBatcher batcher;
+
+// frames taken from the radio as it announces them, in order of arrival; the radio frees a
+// frame of an unknown protocol once its event is raised, so they have to be taken right away
+static FrameBuffer *pendingFrames;
+static int pendingCount;
+
+static void takeFrame(MicroBitEvent) {
+    if (pendingCount >= RADIO_PENDING_QUEUE_SIZE)
+        return; // the radio frees it
+    FrameBuffer *p = uBit.radio.recv();
+    if (!p)
+        return;
+    p->next = NULL;
+    FrameBuffer **tail = &pendingFrames;
+    while (*tail)
+        tail = &(*tail)->next;
+    *tail = p;
+    pendingCount++;
+}
+
+// sorts the frames taken from the radio into the protocol queue
+static void receiveFrames() {
+    for (;;) {
+        __disable_irq();
+        FrameBuffer *p = pendingFrames;
+        if (p) {
+            pendingFrames = p->next;
+            pendingCount--;
+        }
+        __enable_irq();
+        if (!p)
+            return;
+
+        int len = p->length - (MICROBIT_RADIO_HEADER_SIZE - 1);
+        if (len > 0 && len <= MICROBIT_RADIO_MAX_PACKET_SIZE) {
+            stats.received(len);
+            if (p->payload[0] == RADIO_FRAME_TYPE_BATCH)
+                RadioBatcher::unpack(p->payload, len, p->rssi);
+            else
+                deliver(p->payload, len, p->rssi);
+        }
+        delete p;
+    }
+}
+
+static void onFrames(MicroBitEvent) {
+    receiveFrames();
+}
+
+/**
+ * Batches the frames sent with ``sendProtocolPacket`` into shared radio frames. A frame is
+ * sent when it is full or when its oldest frame has waited for the latency. Receivers unpack
+ * batches whatever their setting. Radio frames hold 32 bytes; header compression lets frames
+ * between the same two devices share their 8 bytes of serial numbers, so a reliable
+ * acknowledgment and a reliable message of up to 6 bytes to the same device fit in one.
+ * @param latency longest time in milliseconds a frame is held back, or 0 to send every frame at once, eg: 20
+ * @param compressHeaders whether frames of a batch share their serial numbers
+ */
+//% advanced=true
+void setBatching(int latency, bool compressHeaders = true) {
+    if (radioEnable() != MICROBIT_OK)
+        return;
+    batcher.configure(latency, compressHeaders);
+}
+
+/**
+ * Gets a traffic counter of the protocols layered on the radio, such as the reliable
+ * transport. Frames are what goes on air; packets are the protocol frames sent and handled,
+ * so batching makes them differ.
+ * @param statistic the counter to read
+ */
+//% advanced=true
+int statistic(RadioStatistic statistic) {
+    stats.update();
+    switch (statistic) {
+    case RadioStatistic::FramesPerSecond:
+        return stats.framesPerSecond;
+    case RadioStatistic::BytesPerSecond:
+        return stats.bytesPerSecond;
+    default:
+        return stats.counters[(int)statistic];
+    }
+}
+
+/**
+ * Internal use only. Sends a frame of a protocol layered on the radio. Such frames are
+ * never seen by ``readRawPacket``.
+ * @param frame the frame, starting with its type, 32 or more
+ */
+//%
+void sendProtocolPacket(Buffer frame) {
+    if (radioEnable() != MICROBIT_OK || NULL == frame || frame->length == 0 ||
+        frame->data[0] < RADIO_FRAME_TYPE_PROTOCOL)
+        return;
+    int len = min(frame->length, MICROBIT_RADIO_MAX_PACKET_SIZE);
+    stats.counters[(int)RadioStatistic::PacketsSent]++;
+    if (batcher.latency > 0 && batcher.add(frame->data, len))
+        return;
+    batcher.flush();
+    sendFrame(frame->data, len);
+}
+
+/**
+ * Internal use only. Takes the next frame of a protocol layered on the radio from the queue
+ * and returns its contents + RSSI in a Buffer.
+ * @param type the frame type of the protocol, 32 or more
+ * @returns NULL if no frame of that type is available
+ */
+//%
+Buffer readProtocolPacket(int type) {
+    if (radioEnable() != MICROBIT_OK)
+        return NULL;
+    receiveFrames();
+    return protocolPackets.pop(type);
+}
+
+/**
+ * Internal use only. Runs some code when a frame of a protocol layered on the radio arrives.
+ * Frames are only kept for the types that have a handler.
+ * @param type the frame type of the protocol, 32 or more
+ */
+//%
+void onProtocolPacket(int type, Action body) {
+    static bool listening;
+    if (radioEnable() != MICROBIT_OK || type < RADIO_FRAME_TYPE_PROTOCOL || type > 255)
+        return;
+    registerWithDal(RADIO_PROTOCOL_EVT_ID, type, body);
+    handledTypes[type >> 5] |= 1u << (type & 31);
+    if (!listening) {
+        // the radio raises the event from its interrupt, so the immediate listener only takes
+        // the frame; the queued one sorts it in a fiber
+        uBit.messageBus.listen(MICROBIT_ID_RADIO_DATA_READY, RADIO_PROTOCOL_LAYERED, takeFrame,
+                               MESSAGE_BUS_LISTENER_IMMEDIATE);
+        uBit.messageBus.listen(MICROBIT_ID_RADIO_DATA_READY, RADIO_PROTOCOL_LAYERED, onFrames);
+        listening = true;
+    }
+}
+
+} // namespace radio
@@ -84,5 +84,53 @@ declare namespace radio {
     //% advanced=true shim=radio::setFrequencyBand
     function setFrequencyBand(band: int32): void;
 }
+declare namespace radio {
+
+    /**
+     * Batches the frames sent with ``sendProtocolPacket`` into shared radio frames. A frame is
+     * sent when it is full or when its oldest frame has waited for the latency. Receivers unpack
+     * batches whatever their setting. Radio frames hold 32 bytes; header compression lets frames
+     * between the same two devices share their 8 bytes of serial numbers, so a reliable
+     * acknowledgment and a reliable message of up to 6 bytes to the same device fit in one.
+     * @param latency longest time in milliseconds a frame is held back, or 0 to send every frame at once, eg: 20
+     * @param compressHeaders whether frames of a batch share their serial numbers
+     */
+    //% advanced=true compressHeaders.defl=1 shim=radio::setBatching
+    function setBatching(latency: int32, compressHeaders?: boolean): void;
+
+    /**
+     * Gets a traffic counter of the protocols layered on the radio, such as the reliable
+     * transport. Frames are what goes on air; packets are the protocol frames sent and handled,
+     * so batching makes them differ.
+     * @param statistic the counter to read
+     */
+    //% advanced=true shim=radio::statistic
+    function statistic(statistic: RadioStatistic): int32;
+
+    /**
+     * Internal use only. Sends a frame of a protocol layered on the radio. Such frames are
+     * never seen by ``readRawPacket``.
+     * @param frame the frame, starting with its type, 32 or more
+     */
+    //% shim=radio::sendProtocolPacket
+    function sendProtocolPacket(frame: Buffer): void;
+
+    /**
+     * Internal use only. Takes the next frame of a protocol layered on the radio from the queue
+     * and returns its contents + RSSI in a Buffer.
+     * @param type the frame type of the protocol, 32 or more
+     * @returns NULL if no frame of that type is available
+     */
+    //% shim=radio::readProtocolPacket
+    function readProtocolPacket(type: int32): Buffer;
+
+    /**
+     * Internal use only. Runs some code when a frame of a protocol layered on the radio arrives.
+     * Frames are only kept for the types that have a handler.
+     * @param type the frame type of the protocol, 32 or more
+     */
+    //% shim=radio::onProtocolPacket
+    function onProtocolPacket(type: int32, body: () => void): void;
+}
 
 // Auto-generated. Do not edit. Really.
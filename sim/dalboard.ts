@@ -19,6 +19,7 @@ namespace pxsim {
         lightSensorState: LightSensorState;
         buttonPairState: ButtonPairState;
         radioState: RadioState;
+        radioProtocolState: RadioProtocolState;
         microphoneState: MicrophoneState;
         recordingState: RecordingState;
         lightState: pxt.Map<CommonNeoPixelState>;
@@ -98,6 +99,7 @@ namespace pxsim {
                 ID_RADIO: DAL.MICROBIT_ID_RADIO,
                 RADIO_EVT_DATAGRAM: DAL.MICROBIT_RADIO_EVT_DATAGRAM
             });
+            this.radioProtocolState = new RadioProtocolState(this.radioState);
             this.builtinParts["microphone"] = this.microphoneState = new MicrophoneState(DAL.DEVICE_ID_MICROPHONE, 0, 255, 86, 165);
             this.builtinParts["recording"] = this.recordingState = new RecordingState();
             this.builtinParts["accelerometer"] = this.accelerometerState = new AccelerometerState(runtime);
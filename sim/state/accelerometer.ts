@@ -59,6 +59,125 @@ namespace pxsim.input {
         let b = board().accelerometerState;
         b.accelerometer.setSampleRange(range);
     }
+
+    const ACCELEROMETER_STREAM_ID = 9512;
+    const ACCELEROMETER_STREAM_BLOCKS = 4;
+    let accelerationBlocks: RefBuffer[] = [];
+    let accelerationOverruns = 0;
+    let accelerationStreamer: any;
+    // the program that started the stream; the timer outlives it when the simulator restarts
+    let accelerationRuntime: Runtime;
+
+    // the simulator has no sample clock, so each block repeats the current reading
+    export function startAccelerationStream(sampleRate: number, samplesPerBlock: number) {
+        stopAccelerationStream();
+        accelerationBlocks = [];
+        accelerationOverruns = 0;
+        sampleRate = Math.max(1, sampleRate | 0);
+        samplesPerBlock = Math.max(1, Math.min(1000, samplesPerBlock | 0));
+        const acc = board().accelerometerState.accelerometer;
+        acc.activate();
+        const rt = accelerationRuntime = runtime;
+        const timer = accelerationStreamer = setInterval(() => {
+            if (runtime !== rt) {
+                clearInterval(timer);
+                return;
+            }
+            if (accelerationBlocks.length == ACCELEROMETER_STREAM_BLOCKS) {
+                accelerationOverruns += samplesPerBlock;
+                return;
+            }
+            const buf = BufferMethods.createBuffer(samplesPerBlock * 6);
+            const xyz = [acc.getX(), acc.getY(), acc.getZ()];
+            for (let i = 0; i < samplesPerBlock * 3; ++i) {
+                const v = xyz[i % 3] & 0xffff;
+                buf.data[i * 2] = v & 0xff;
+                buf.data[i * 2 + 1] = v >> 8;
+            }
+            accelerationBlocks.push(buf);
+            board().bus.queue(ACCELEROMETER_STREAM_ID, 1);
+        }, Math.max(1, samplesPerBlock * 1000 / sampleRate));
+    }
+
+    export function stopAccelerationStream() {
+        if (accelerationStreamer) {
+            clearInterval(accelerationStreamer);
+            accelerationStreamer = undefined;
+        }
+    }
+
+    export function readAccelerationBlock(): RefBuffer {
+        if (accelerationRuntime !== runtime)
+            return undefined;
+        return accelerationBlocks.shift();
+    }
+
+    export function onAccelerationBlock(handler: RefAction) {
+        pxtcore.registerWithDal(ACCELEROMETER_STREAM_ID, 1, handler);
+    }
+
+    export function accelerationStreamOverruns(): number {
+        return accelerationRuntime === runtime ? accelerationOverruns : 0;
+    }
+
+    function readXYZ(buf: RefBuffer, i: number) {
+        const d = buf.data;
+        const r: number[] = [];
+        for (let k = 0; k < 3; ++k) {
+            const o = (i * 3 + k) * 2;
+            r.push(((d[o] | (d[o + 1] << 8)) << 16) >> 16);
+        }
+        return r;
+    }
+
+    function writeInt16(buf: RefBuffer, i: number, v: number) {
+        v = Math.max(-32768, Math.min(32767, v)) & 0xffff;
+        buf.data[i * 2] = v & 0xff;
+        buf.data[i * 2 + 1] = v >> 8;
+    }
+
+    export function accelerationMagnitudes(samples: RefBuffer): RefBuffer {
+        if (!samples)
+            return undefined;
+        const n = samples.data.length / 6 | 0;
+        const res = BufferMethods.createBuffer(n * 2);
+        for (let i = 0; i < n; ++i) {
+            const [x, y, z] = readXYZ(samples, i);
+            writeInt16(res, i, Math.floor(Math.sqrt(x * x + y * y + z * z)));
+        }
+        return res;
+    }
+
+    export function normalizeAccelerations(samples: RefBuffer): RefBuffer {
+        if (!samples)
+            return undefined;
+        const n = samples.data.length / 6 | 0;
+        const res = BufferMethods.createBuffer(n * 6);
+        for (let i = 0; i < n; ++i) {
+            const v = readXYZ(samples, i);
+            const m = Math.floor(Math.sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]));
+            for (let k = 0; k < 3; ++k)
+                writeInt16(res, i * 3 + k, m ? Math.floor(v[k] * 32768 / m) : 0);
+        }
+        return res;
+    }
+
+    const CUSTOM_GESTURE_ID = 9513;
+
+    // the simulated accelerometer cannot perform recorded movements; recording just waits
+    export function recordCustomGesture(gesture: number, duration: number) {
+        board().accelerometerState.accelerometer.activate();
+        basic.pause(Math.min(duration, 1280));
+    }
+
+    export function clearCustomGesture(gesture: number) { }
+
+    export function setCustomGestureTolerance(tolerance: number) { }
+
+    export function onCustomGesture(gesture: number, body: RefAction) {
+        board().accelerometerState.accelerometer.activate();
+        pxtcore.registerWithDal(CUSTOM_GESTURE_ID, gesture, body);
+    }
 }
 
 namespace pxsim {
@@ -12,4 +12,52 @@ namespace pxsim.input {
         // TODO
         return 0;
     }
+
+    let orientationFusion = false;
+
+    // the simulated sensors do not jitter, so the raw readings stand in for the fused ones
+    export function startOrientationFusion(rate: number, responsiveness: number) {
+        orientationFusion = true;
+        compassHeading();
+        board().accelerometerState.accelerometer.activate();
+    }
+
+    export function stopOrientationFusion() {
+        orientationFusion = false;
+    }
+
+    export function fusedHeading(): number {
+        return orientationFusion ? board().compassState.heading : 0;
+    }
+
+    export function fusedPitch(): number {
+        return orientationFusion ? board().accelerometerState.accelerometer.getPitch() : 0;
+    }
+
+    export function fusedRoll(): number {
+        return orientationFusion ? board().accelerometerState.accelerometer.getRoll() : 0;
+    }
+
+    export function orientationQuaternion(index: number): number {
+        if (!orientationFusion)
+            return index == 0 ? 1 : 0;
+        const acc = board().accelerometerState.accelerometer;
+        const r = acc.getRollRadians() / 2;
+        const p = acc.getPitchRadians() / 2;
+        const y = board().compassState.heading * Math.PI / 360;
+        const cr = Math.cos(r), sr = Math.sin(r);
+        const cp = Math.cos(p), sp = Math.sin(p);
+        const cy = Math.cos(y), sy = Math.sin(y);
+        switch (index) {
+            case 0: return cr * cp * cy + sr * sp * sy;
+            case 1: return sr * cp * cy - cr * sp * sy;
+            case 2: return cr * sp * cy + sr * cp * sy;
+            case 3: return cr * cp * sy - sr * sp * cy;
+            default: return 0;
+        }
+    }
+
+    export function clearCompassCalibration() {
+        // the simulated compass never needs calibrating
+    }
 }
\ No newline at end of file
@@ -0,0 +1,225 @@
+namespace pxsim.inference {
+    const MODEL_MAGIC = 0x314e3849;
+
+    function int8(b: Uint8Array, i: number) {
+        return (b[i] << 24) >> 24;
+    }
+
+    function read16(b: Uint8Array, i: number) {
+        return b[i] | (b[i + 1] << 8);
+    }
+
+    function read32(b: Uint8Array, i: number) {
+        return b[i] | (b[i + 1] << 8) | (b[i + 2] << 16) | (b[i + 3] << 24);
+    }
+
+    function requantize(acc: number, mult: number, shift: number, zero: number, lo: number) {
+        const total = 31 + shift;
+        const v = Math.floor((acc * mult + Math.pow(2, total - 1)) / Math.pow(2, total)) + zero;
+        return Math.max(lo, Math.min(127, v));
+    }
+
+    export function run(model: RefBuffer, input: RefBuffer): RefBuffer {
+        const m = model && model.data;
+        if (!m || !input || m.length < 8 || (read32(m, 0) >>> 0) != MODEL_MAGIC)
+            return undefined;
+        const numLayers = m[4];
+        if (!numLayers || input.data.length != read16(m, 6))
+            return undefined;
+
+        let x: number[] = [];
+        for (let i = 0; i < input.data.length; ++i)
+            x.push(int8(input.data, i));
+        let p = 8;
+        for (let n = 0; n < numLayers; ++n) {
+            if (p + 20 > m.length)
+                return undefined;
+            const type = m[p], relu = m[p + 1] == 1;
+            const inLength = read16(m, p + 2), outLength = read16(m, p + 4);
+            const inCh = m[p + 6], outCh = m[p + 7], kernel = m[p + 8], stride = m[p + 9];
+            const inZero = int8(m, p + 10), outZero = int8(m, p + 11);
+            const mult = read32(m, p + 12), shift = int8(m, p + 16);
+            const lo = relu ? outZero : -128;
+            const w = p + 20;
+            const out: number[] = [];
+            if (inLength * inCh != x.length || shift < -30 || shift > 31)
+                return undefined;
+            if (type == 1) {
+                const b = w + inLength * outLength;
+                p = b + 4 * outLength;
+                if (inCh != 1 || outCh != 1 || p > m.length)
+                    return undefined;
+                for (let o = 0; o < outLength; ++o) {
+                    let acc = read32(m, b + o * 4);
+                    for (let i = 0; i < inLength; ++i)
+                        acc += (x[i] - inZero) * int8(m, w + o * inLength + i);
+                    out.push(requantize(acc, mult, shift, outZero, lo));
+                }
+            } else if (type == 2) {
+                const window = kernel * inCh;
+                const b = w + outCh * window;
+                p = b + 4 * outCh;
+                if (!kernel || !stride || kernel > inLength || p > m.length
+                    || outLength != Math.floor((inLength - kernel) / stride) + 1)
+                    return undefined;
+                for (let t = 0; t < outLength; ++t)
+                    for (let c = 0; c < outCh; ++c) {
+                        let acc = read32(m, b + c * 4);
+                        for (let k = 0; k < window; ++k)
+                            acc += (x[t * stride * inCh + k] - inZero) * int8(m, w + c * window + k);
+                        out.push(requantize(acc, mult, shift, outZero, lo));
+                    }
+            } else if (type == 3) {
+                p = w;
+                if (!kernel || inCh != outCh || outLength != Math.floor(inLength / kernel))
+                    return undefined;
+                for (let t = 0; t < outLength; ++t)
+                    for (let c = 0; c < inCh; ++c) {
+                        let v = -128;
+                        for (let k = 0; k < kernel; ++k)
+                            v = Math.max(v, x[(t * kernel + k) * inCh + c]);
+                        out.push(v);
+                    }
+            } else {
+                return undefined;
+            }
+            x = out;
+        }
+
+        const res = BufferMethods.createBuffer(x.length);
+        for (let i = 0; i < x.length; ++i)
+            res.data[i] = x[i] & 0xff;
+        return res;
+    }
+
+    export function quantizeInt16(samples: RefBuffer, shift: number): RefBuffer {
+        if (!samples)
+            return undefined;
+        const n = samples.data.length >> 1;
+        const res = BufferMethods.createBuffer(n);
+        shift = Math.max(0, Math.min(15, shift | 0));
+        for (let i = 0; i < n; ++i) {
+            const v = (read16(samples.data, i * 2) << 16) >> 16 >> shift;
+            res.data[i] = Math.max(-128, Math.min(127, v)) & 0xff;
+        }
+        return res;
+    }
+}
+
+namespace pxsim.spectrum {
+    const SPECTRUM_ID = 9515;
+    const SPECTRUM_MAX_BANDS = 8;
+
+    interface Band {
+        low: number;
+        high: number;
+        threshold: number;
+        level: number;
+        above: boolean;
+    }
+    const bands: Band[] = [];
+
+    function fftPoints(samples: RefBuffer) {
+        if (!samples)
+            return 0;
+        let n = 4;
+        while (n * 2 <= 1024 && samples.data.length >= n * 4)
+            n <<= 1;
+        return samples.data.length >= n * 2 ? n : 0;
+    }
+
+    // same scaling as the native fixed-point FFT: 1 / (2n)
+    function computeMagnitudes(samples: RefBuffer, n: number, window: boolean) {
+        const re: number[] = [];
+        const im: number[] = [];
+        for (let i = 0; i < n; ++i) {
+            let v = ((samples.data[2 * i] | (samples.data[2 * i + 1] << 8)) << 16) >> 16;
+            if (window)
+                v *= 0.5 - 0.5 * Math.cos(2 * Math.PI * i / n);
+            re.push(v);
+            im.push(0);
+        }
+        for (let i = 1, j = 0; i < n; ++i) {
+            let bit = n >> 1;
+            for (; j & bit; bit >>= 1)
+                j ^= bit;
+            j |= bit;
+            if (i < j) {
+                [re[i], re[j]] = [re[j], re[i]];
+                [im[i], im[j]] = [im[j], im[i]];
+            }
+        }
+        for (let half = 1; half < n; half <<= 1) {
+            for (let m = 0; m < half; ++m) {
+                const wr = Math.cos(Math.PI * m / half);
+                const wi = -Math.sin(Math.PI * m / half);
+                for (let i = m; i < n; i += half << 1) {
+                    const j = i + half;
+                    const tr = wr * re[j] - wi * im[j];
+                    const ti = wr * im[j] + wi * re[j];
+                    re[j] = re[i] - tr;
+                    im[j] = im[i] - ti;
+                    re[i] += tr;
+                    im[i] += ti;
+                }
+            }
+        }
+        const out: number[] = [];
+        for (let i = 0; i < n / 2; ++i)
+            out.push(Math.floor(Math.sqrt(re[i] * re[i] + im[i] * im[i]) / (2 * n)));
+        return out;
+    }
+
+    export function magnitudes(samples: RefBuffer, window: boolean): RefBuffer {
+        const n = fftPoints(samples);
+        if (!n)
+            return undefined;
+        const mags = computeMagnitudes(samples, n, window);
+        const res = BufferMethods.createBuffer(n);
+        for (let i = 0; i < mags.length; ++i) {
+            res.data[i * 2] = mags[i] & 0xff;
+            res.data[i * 2 + 1] = (mags[i] >> 8) & 0xff;
+        }
+        return res;
+    }
+
+    export function setBand(band: number, low: number, high: number, threshold: number) {
+        if (band < 0 || band >= SPECTRUM_MAX_BANDS)
+            return;
+        bands[band] = { low, high: Math.max(low, high), threshold, level: 0, above: false };
+    }
+
+    export function analyze(samples: RefBuffer, sampleRate: number) {
+        const n = fftPoints(samples);
+        if (sampleRate <= 0 || !n)
+            return;
+        const mags = computeMagnitudes(samples, n, true);
+        bands.forEach((b, i) => {
+            if (!b) return;
+            let from = Math.max(0, Math.floor((b.low * n + sampleRate - 1) / sampleRate));
+            let to = Math.min(n / 2 - 1, Math.floor(b.high * n / sampleRate));
+            if (from > to)
+                from = to = Math.min(n / 2 - 1, Math.floor((b.low * n + (sampleRate >> 1)) / sampleRate));
+            let sum = 0;
+            for (let k = from; k <= to; ++k)
+                sum += mags[k];
+            b.level = Math.floor(sum / (to - from + 1));
+            if (!b.above && b.level > b.threshold) {
+                b.above = true;
+                board().bus.queue(SPECTRUM_ID, i * 2 + 1);
+            } else if (b.above && b.level < b.threshold / 2) {
+                b.above = false;
+                board().bus.queue(SPECTRUM_ID, i * 2 + 2);
+            }
+        });
+    }
+
+    export function bandEnergy(band: number): number {
+        const b = bands[band];
+        return b ? b.level : 0;
+    }
+
+    export function onBandEnergy(band: number, event: number, handler: RefAction) {
+        pxtcore.registerWithDal(SPECTRUM_ID, band * 2 + event, handler);
+    }
+}
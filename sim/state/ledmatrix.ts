@@ -1,7 +1,8 @@
 namespace pxsim {
     export enum DisplayMode {
         bw,
-        greyscale
+        greyscale,
+        ditheredGreyscale = 16
     }
 
     export class LedMatrixState {
@@ -159,6 +160,7 @@ namespace pxsim.images {
 namespace pxsim.ImageMethods {
     export function showImage(leds: Image, offset: number, interval: number) {
         pxtrt.nullCheck(leds)
+        led.cancelAnimation();
         offset = offset >> 0;
         interval = interval >> 0;
         let cb = getResume();
@@ -181,6 +183,7 @@ namespace pxsim.ImageMethods {
 
     export function plotImage(leds: Image, offset: number): void {
         pxtrt.nullCheck(leds)
+        led.cancelAnimation();
         offset = offset >> 0;
 
         leds = clampPixelBrightness(leds);
@@ -238,6 +241,7 @@ namespace pxsim.ImageMethods {
 
     export function scrollImage(leds: Image, stride: number, interval: number): void {
         pxtrt.nullCheck(leds)
+        led.cancelAnimation();
         stride = stride >> 0;
         interval = interval >> 0;
         if (stride == 0) stride = 1;
@@ -267,6 +271,63 @@ namespace pxsim.ImageMethods {
         })
     }
 
+    export function drawImage(i: Image, src: Image, x: number, y: number, mode: number) {
+        pxtrt.nullCheck(i)
+        if (!src) return;
+        blit(i, x | 0, y | 0, src, 0, 0, src.width, src.height, mode | 0);
+    }
+
+    export function copyRegion(i: Image, src: Image, srcX: number, srcY: number, w: number, h: number, x: number, y: number) {
+        pxtrt.nullCheck(i)
+        if (!src) return;
+        blit(i, x | 0, y | 0, src, srcX | 0, srcY | 0, w | 0, h | 0, 0);
+    }
+
+    export function shift(i: Image, dx: number, dy: number) {
+        pxtrt.nullCheck(i)
+        dx |= 0;
+        dy |= 0;
+        const old = new Image(i.width, i.data.slice());
+        i.clear();
+        blit(i, dx, dy, old, 0, 0, i.width, i.height, 0);
+    }
+
+    export function invert(i: Image) {
+        pxtrt.nullCheck(i)
+        for (let k = 0; k < i.data.length; ++k)
+            i.data[k] = 0xff - (i.data[k] || 0);
+    }
+
+    export function fill(i: Image, value: number) {
+        pxtrt.nullCheck(i)
+        value = Math.max(0, Math.min(0xff, value | 0));
+        for (let k = 0; k < i.data.length; ++k)
+            i.data[k] = value;
+    }
+
+    function blit(dst: Image, dx: number, dy: number, src: Image, sx: number, sy: number, w: number, h: number, mode: number) {
+        // snapshot the source so that overlapping copies within one image behave like the device
+        if (src === dst) src = new Image(src.width, src.data.slice());
+        for (let y = 0; y < h; ++y) {
+            for (let x = 0; x < w; ++x) {
+                const tx = dx + x;
+                const ty = dy + y;
+                const fx = sx + x;
+                const fy = sy + y;
+                if (tx < 0 || ty < 0 || tx >= dst.width || ty >= dst.height
+                    || fx < 0 || fy < 0 || fx >= src.width || fy >= src.height) continue;
+                const v = src.get(fx, fy) || 0;
+                const d = dst.get(tx, ty) || 0;
+                switch (mode) {
+                    case 1: dst.set(tx, ty, d | v); break;
+                    case 2: dst.set(tx, ty, d ^ v); break;
+                    case 3: dst.set(tx, ty, Math.max(d, v)); break;
+                    default: dst.set(tx, ty, v); break;
+                }
+            }
+        }
+    }
+
     function clampPixelBrightness(img: Image): Image {
         let res = img;
         if (led.displayMode() === DisplayMode.greyscale && led.brightness() < 0xff) {
@@ -314,6 +375,7 @@ namespace pxsim.basic {
     }
 
     export function clearScreen() {
+        led.cancelAnimation();
         board().ledMatrixState.image.clear();
         runtime.queueDisplayUpdate()
     }
@@ -330,6 +392,7 @@ namespace pxsim.basic {
 
 namespace pxsim.led {
     export function plot(x: number, y: number) {
+        cancelAnimation();
         x |= 0;
         y |= 0;
         board().ledMatrixState.image.set(x, y, 0xff);
@@ -337,6 +400,7 @@ namespace pxsim.led {
     }
 
     export function plotBrightness(x: number, y: number, brightness: number) {
+        cancelAnimation();
         x |= 0;
         y |= 0;
         const state = board().ledMatrixState;
@@ -348,7 +412,23 @@ namespace pxsim.led {
         runtime.queueDisplayUpdate()
     }
 
+    export function setFrame(frame: RefBuffer) {
+        if (!frame) return;
+        cancelAnimation();
+        const state = board().ledMatrixState;
+        const data = state.image.data;
+        const len = Math.min(frame.data.length, data.length);
+        for (let i = 0; i < len; ++i) {
+            const v = frame.data[i];
+            if (v != 0 && v != 0xff && state.displayMode != DisplayMode.greyscale)
+                state.displayMode = DisplayMode.greyscale;
+            data[i] = v;
+        }
+        runtime.queueDisplayUpdate()
+    }
+
     export function unplot(x: number, y: number) {
+        cancelAnimation();
         x |= 0;
         y |= 0;
         board().ledMatrixState.image.set(x, y, 0);
@@ -372,10 +452,93 @@ namespace pxsim.led {
     }
 
     export function stopAnimation(): void {
+        cancelAnimation();
         board().ledMatrixState.animationQ.cancelAll();
         board().ledMatrixState.image.clear();
     }
 
+    const LED_ANIMATION_ID = 9510;
+    let animationTimer: any;
+    // the program that started the animation; the timer outlives it when the simulator restarts
+    let animationRuntime: Runtime;
+
+    export function playAnimation(frames: Image, durations: RefBuffer, loop: boolean, ease: boolean): void {
+        pxtrt.nullCheck(frames)
+        cancelAnimationTimer();
+        const numFrames = (frames.width / 5) | 0;
+        if (!numFrames) return;
+        const ds: number[] = [];
+        if (durations)
+            for (let i = 0; i + 1 < durations.data.length; i += 2)
+                ds.push(Math.max(1, durations.data[i] | (durations.data[i + 1] << 8)));
+        if (!ds.length) ds.push(400);
+        const duration = (i: number) => ds[Math.min(i, ds.length - 1)];
+        const state = board().ledMatrixState;
+        if (ease) state.displayMode = DisplayMode.greyscale;
+
+        let frame = 0;
+        let frameStart = runtime.runningTime();
+        const render = (a: number, b: number, t: number) => {
+            for (let y = 0; y < 5; ++y)
+                for (let x = 0; x < 5; ++x) {
+                    const from = frames.get(a * 5 + x, y) || 0;
+                    const to = frames.get(b * 5 + x, y) || 0;
+                    state.image.set(x, y, Math.round(from + (to - from) * t));
+                }
+            runtime.queueDisplayUpdate();
+        }
+        render(0, 0, 0);
+        const rt = animationRuntime = runtime;
+        const timer = animationTimer = setInterval(() => {
+            if (runtime !== rt) {
+                clearInterval(timer);
+                if (animationTimer === timer)
+                    animationTimer = undefined;
+                return;
+            }
+            let elapsed = runtime.runningTime() - frameStart;
+            while (elapsed >= duration(frame)) {
+                elapsed -= duration(frame);
+                frameStart += duration(frame);
+                if (++frame >= numFrames) {
+                    if (!loop) {
+                        render(numFrames - 1, numFrames - 1, 0);
+                        cancelAnimationTimer();
+                        board().bus.queue(LED_ANIMATION_ID, 1);
+                        return;
+                    }
+                    frame = 0;
+                    board().bus.queue(LED_ANIMATION_ID, 3);
+                }
+            }
+            const next = frame + 1 < numFrames ? frame + 1 : loop ? 0 : frame;
+            const t = elapsed / duration(frame);
+            render(frame, ease ? next : frame, ease ? t * t * (3 - 2 * t) : 0);
+        }, 20);
+    }
+
+    function cancelAnimationTimer() {
+        if (animationTimer) {
+            clearInterval(animationTimer);
+            animationTimer = undefined;
+            return animationRuntime === runtime;
+        }
+        return false;
+    }
+
+    export function cancelAnimation(): void {
+        if (cancelAnimationTimer())
+            board().bus.queue(LED_ANIMATION_ID, 2);
+    }
+
+    export function isAnimationPlaying(): boolean {
+        return !!animationTimer && animationRuntime === runtime;
+    }
+
+    export function onAnimationEvent(event: number, body: RefAction): void {
+        pxtcore.registerWithDal(LED_ANIMATION_ID, event, body);
+    }
+
     export function setDisplayMode(mode: DisplayMode): void {
         board().ledMatrixState.displayMode = mode;
         runtime.queueDisplayUpdate()
@@ -385,6 +548,26 @@ namespace pxsim.led {
         return board().ledMatrixState.displayMode;
     }
 
+    export function setFrameDithered(frame: RefBuffer) {
+        if (!frame) return;
+        cancelAnimation();
+        const state = board().ledMatrixState;
+        state.displayMode = DisplayMode.ditheredGreyscale;
+        const data = state.image.data;
+        const len = Math.min(frame.data.length >> 1, data.length);
+        for (let i = 0; i < len; ++i)
+            data[i] = (frame.data[2 * i] | (frame.data[2 * i + 1] << 8)) / 257;
+        runtime.queueDisplayUpdate()
+    }
+
+    export function setDitherOptions(bits: number, divider: number) {
+        // the simulator renders fractional brightness directly
+    }
+
+    export function ditherUpdateCost(longest: boolean): number {
+        return 0;
+    }
+
     export function screenshot(): Image {
         let img = createImage(5)
         board().ledMatrixState.image.copyTo(0, 5, img, 0);
@@ -1,5 +1,26 @@
 namespace pxsim.input {
-    export function lightLevel(): number {
+    const LIGHT_LEVEL_ID = 9511;
+    let lightThresholds = [32, 200];
+    let lightCondition = 0;
+    let lightSampler: any;
+    // smoothed light level, -1 until the first sample
+    let smoothedLightLevel = -1;
+    let lightRuntime: Runtime;
+
+    // the sampler and thresholds of an earlier program are dropped when the simulator restarts
+    function checkLightRuntime() {
+        if (lightRuntime === runtime)
+            return;
+        lightRuntime = runtime;
+        if (lightSampler)
+            clearInterval(lightSampler);
+        lightSampler = undefined;
+        smoothedLightLevel = -1;
+        lightThresholds = [32, 200];
+        lightCondition = 0;
+    }
+
+    function readLightLevel(): number {
         let b = board().lightSensorState;
         if (!b.usesLightLevel) {
             b.usesLightLevel = true;
@@ -7,4 +28,56 @@ namespace pxsim.input {
         }
         return b.lightLevel;
     }
+
+    export function lightLevel(): number {
+        checkLightRuntime();
+        if (lightSampler && smoothedLightLevel >= 0)
+            return smoothedLightLevel | 0;
+        return readLightLevel();
+    }
+
+    export function setLightLevelSampling(period: number, smoothing: number) {
+        checkLightRuntime();
+        if (lightSampler) {
+            clearInterval(lightSampler);
+            lightSampler = undefined;
+        }
+        smoothedLightLevel = -1;
+        period |= 0;
+        if (period <= 0) return;
+        const keep = Math.max(0, Math.min(99, smoothing | 0)) / 100;
+        const rt = runtime;
+        const timer = lightSampler = setInterval(() => {
+            if (runtime !== rt) {
+                clearInterval(timer);
+                return;
+            }
+            // as on the device, measuring light would turn a greyscale screen black and white
+            const mode = led.displayMode();
+            if (mode == DisplayMode.greyscale || mode == DisplayMode.ditheredGreyscale)
+                return;
+            const v = readLightLevel();
+            smoothedLightLevel = smoothedLightLevel < 0 ? v : smoothedLightLevel + (v - smoothedLightLevel) * (1 - keep);
+            const level = smoothedLightLevel | 0;
+            if (level <= lightThresholds[0] && lightCondition != 1) {
+                lightCondition = 1;
+                board().bus.queue(LIGHT_LEVEL_ID, lightCondition);
+            } else if (level >= lightThresholds[1] && lightCondition != 2) {
+                lightCondition = 2;
+                board().bus.queue(LIGHT_LEVEL_ID, lightCondition);
+            }
+        }, period);
+    }
+
+    export function onLightCondition(condition: number, handler: RefAction) {
+        checkLightRuntime();
+        if (!lightSampler)
+            setLightLevelSampling(100, 80);
+        pxtcore.registerWithDal(LIGHT_LEVEL_ID, condition, handler);
+    }
+
+    export function setLightThreshold(condition: number, value: number) {
+        checkLightRuntime();
+        lightThresholds[condition == 1 ? 0 : 1] = Math.max(0, Math.min(0xff, value | 0));
+    }
 }
\ No newline at end of file
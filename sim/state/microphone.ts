@@ -25,4 +25,155 @@ namespace pxsim.input {
             b.setLowThreshold(threshold);
     }
 
+    const MICROPHONE_STREAM_ID = 9514;
+    const MICROPHONE_STREAM_BLOCKS = 4;
+    let microphoneBlocks: RefBuffer[] = [];
+    let microphoneOverruns = 0;
+    let microphoneStreamer: any;
+    // the program that started the stream; the timer outlives it when the simulator restarts
+    let microphoneRuntime: Runtime;
+
+    // the simulator has no audio input, so blocks hold noise as loud as the simulated level
+    export function startMicrophoneStream(sampleRate: number, samplesPerBlock: number, format: number) {
+        stopMicrophoneStream();
+        const b = microphoneState();
+        if (!b) return;
+        b.setUsed();
+        microphoneBlocks = [];
+        microphoneOverruns = 0;
+        sampleRate = Math.max(1, sampleRate | 0);
+        samplesPerBlock = Math.max(1, Math.min(4096, samplesPerBlock | 0));
+        const bytes = format == 1 ? 1 : 2;
+        const rt = microphoneRuntime = runtime;
+        const timer = microphoneStreamer = setInterval(() => {
+            if (runtime !== rt) {
+                clearInterval(timer);
+                return;
+            }
+            if (microphoneBlocks.length == MICROPHONE_STREAM_BLOCKS) {
+                microphoneOverruns += samplesPerBlock;
+                return;
+            }
+            const amplitude = b.getLevel() * 128;
+            const buf = BufferMethods.createBuffer(samplesPerBlock * bytes);
+            for (let i = 0; i < samplesPerBlock; ++i) {
+                const v = Math.round((Math.random() * 2 - 1) * amplitude) & 0xffff;
+                if (bytes == 1)
+                    buf.data[i] = v >> 8;
+                else {
+                    buf.data[i * 2] = v & 0xff;
+                    buf.data[i * 2 + 1] = v >> 8;
+                }
+            }
+            microphoneBlocks.push(buf);
+            board().bus.queue(MICROPHONE_STREAM_ID, 1);
+        }, Math.max(1, samplesPerBlock * 1000 / sampleRate));
+    }
+
+    export function stopMicrophoneStream() {
+        if (microphoneStreamer) {
+            clearInterval(microphoneStreamer);
+            microphoneStreamer = undefined;
+        }
+    }
+
+    export function readMicrophoneBlock(): RefBuffer {
+        if (microphoneRuntime !== runtime)
+            return undefined;
+        return microphoneBlocks.shift();
+    }
+
+    export function onMicrophoneBlock(handler: RefAction) {
+        pxtcore.registerWithDal(MICROPHONE_STREAM_ID, 1, handler);
+    }
+
+    export function microphoneStreamOverruns(): number {
+        return microphoneRuntime === runtime ? microphoneOverruns : 0;
+    }
+
+    const SOUND_ACTIVITY_ID = 9517;
+    const SOUND_ACTIVITY_BACKGROUND = 16;
+    // the simulator has no audio, so the detectors watch the simulated sound level instead
+    let soundActivity: {
+        runtime: Runtime,
+        clapThreshold: number,
+        voiceThreshold: number,
+        lastLevel: number,
+        clapHoldoff: number,
+        voiceFrames: number,
+        silentFrames: number,
+        voice: boolean
+    };
+
+    function soundActivityThreshold(sensitivity: number) {
+        return 32 + (255 - Math.max(0, Math.min(255, sensitivity))) * 224 / 255;
+    }
+
+    function soundActivityDetector() {
+        if (soundActivity && soundActivity.runtime === runtime)
+            return soundActivity;
+        const b = microphoneState();
+        if (!b) return undefined;
+        b.setUsed();
+        const d = soundActivity = {
+            runtime,
+            clapThreshold: soundActivityThreshold(128),
+            voiceThreshold: soundActivityThreshold(128),
+            lastLevel: 0,
+            clapHoldoff: 0,
+            voiceFrames: 0,
+            silentFrames: 0,
+            voice: false
+        };
+        const timer = setInterval(() => {
+            if (runtime !== d.runtime) {
+                clearInterval(timer);
+                return;
+            }
+            // levels go up to 255; compare them against a quiet room at 16, with the
+            // same 4 bit fraction as the thresholds
+            const level = b.getLevel();
+            const ratio = level * 16 / SOUND_ACTIVITY_BACKGROUND;
+            if (d.clapHoldoff) d.clapHoldoff--;
+            else if (ratio > d.clapThreshold && level > d.lastLevel * 3) {
+                d.clapHoldoff = 10;
+                board().bus.queue(SOUND_ACTIVITY_ID, 1);
+            }
+            if (ratio > d.voiceThreshold) {
+                d.silentFrames = 0;
+                if (!d.voice && ++d.voiceFrames >= 3) {
+                    d.voice = true;
+                    board().bus.queue(SOUND_ACTIVITY_ID, 2);
+                }
+            } else {
+                d.voiceFrames = 0;
+                if (d.voice && ++d.silentFrames >= 15) {
+                    d.voice = false;
+                    d.silentFrames = 0;
+                    board().bus.queue(SOUND_ACTIVITY_ID, 3);
+                }
+            }
+            d.lastLevel = level;
+        }, 20);
+        return d;
+    }
+
+    export function onSoundActivity(activity: number, handler: RefAction) {
+        soundActivityDetector();
+        pxtcore.registerWithDal(SOUND_ACTIVITY_ID, activity, handler);
+    }
+
+    export function setSoundActivitySensitivity(activity: number, sensitivity: number) {
+        const d = soundActivityDetector();
+        if (!d) return;
+        if (activity == 1)
+            d.clapThreshold = soundActivityThreshold(sensitivity);
+        else
+            d.voiceThreshold = soundActivityThreshold(sensitivity);
+    }
+
+    export function isVoiceActive(): boolean {
+        const d = soundActivityDetector();
+        return !!d && d.voice;
+    }
 }
\ No newline at end of file
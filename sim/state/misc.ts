@@ -59,6 +59,17 @@ namespace pxsim.input {
     export function calibrateCompass() {
         // device calibrates...
     }
+
+    // simulated sensors are plain fields, so there is nothing to cache
+    export function setSensorCacheTime(ms: number) { }
+
+    export function sensorCacheHits(): number {
+        return 0;
+    }
+
+    export function sensorCacheMisses(): number {
+        return 0;
+    }
 }
 
 namespace pxsim.pins {
@@ -215,6 +226,10 @@ namespace pxsim.light {
         pxsim.sendBufferAsm(clone, pin)
     }
 
+    export function sendAPA102Buffer(buffer: RefBuffer, brightness: number) {
+        // TODO: SPI strips are not rendered in the simulator
+    }
+
     export function setMode(pin: number, mode: number) {
         const lp = neopixelState(pin);
         if (!lp) return;
@@ -17,4 +17,166 @@ namespace pxsim.music {
         const soundExpressionPlaying = pxsim.codal.music.isSoundExpPlaying();
         return audioActive || soundExpressionPlaying || pxsim.record.audioIsPlaying();
     }
+
+    // the simulator does not mix raw samples; it only keeps track of how long each voice plays
+    const SAMPLE_VOICES = 4;
+    let sampleVoices: { end: number, loop: boolean, serial: number }[];
+    let sampleSerial = 0;
+    let sampleRuntime: Runtime;
+
+    function voices() {
+        if (!sampleVoices || sampleRuntime !== runtime) {
+            sampleRuntime = runtime;
+            sampleVoices = [];
+            for (let i = 0; i < SAMPLE_VOICES; ++i)
+                sampleVoices.push({ end: 0, loop: false, serial: 0 });
+        }
+        return sampleVoices;
+    }
+
+    function voicePlaying(v: { end: number, loop: boolean }) {
+        return v.loop || v.end > runtime.runningTime();
+    }
+
+    export function playSample(sample: RefBuffer, sampleRate: number, format: number, loop: boolean, volume: number): number {
+        board().ensureHardwareVersion(2);
+        const length = sample ? sample.data.length / (format == 2 ? 2 : 1) | 0 : 0;
+        if (!length || sampleRate <= 0)
+            return -1;
+        const vs = voices();
+        let k = 0;
+        for (let i = 0; i < vs.length; ++i) {
+            if (!voicePlaying(vs[i])) {
+                k = i;
+                break;
+            }
+            if (vs[i].serial < vs[k].serial)
+                k = i;
+        }
+        vs[k] = {
+            end: runtime.runningTime() + length * 1000 / sampleRate,
+            loop: !!loop,
+            serial: ++sampleSerial
+        };
+        return k;
+    }
+
+    export function stopSample(voice: number) {
+        const vs = voices();
+        for (let i = 0; i < vs.length; ++i)
+            if (voice < 0 || voice == i)
+                vs[i] = { end: 0, loop: false, serial: vs[i].serial };
+    }
+
+    export function isSamplePlaying(voice: number): boolean {
+        const vs = voices();
+        if (voice < 0)
+            return vs.some(voicePlaying);
+        return voice < vs.length && voicePlaying(vs[voice]);
+    }
+
+    // the simulator has a single tone generator, so it sounds the most recent held note
+    let synthNotes: { frequency: number, velocity: number }[] = [];
+
+    function updateSynthTone() {
+        const last = synthNotes[synthNotes.length - 1];
+        if (last)
+            AudioContextManager.tone(last.frequency, last.velocity / 255 / 10);
+        else
+            AudioContextManager.stop();
+    }
+
+    export function synthNoteOn(frequency: number, velocity: number, waveform: number) {
+        board().ensureHardwareVersion(2);
+        if (frequency <= 0 || velocity <= 0)
+            return;
+        synthNotes = synthNotes.filter(n => n.frequency != frequency);
+        synthNotes.push({ frequency, velocity: Math.min(255, velocity) });
+        updateSynthTone();
+    }
+
+    export function synthNoteOff(frequency: number) {
+        const n = synthNotes.length;
+        synthNotes = synthNotes.filter(n => n.frequency != frequency);
+        if (synthNotes.length != n)
+            updateSynthTone();
+    }
+
+    export function synthAllNotesOff() {
+        if (synthNotes.length) {
+            synthNotes = [];
+            updateSynthTone();
+        }
+    }
+
+    export function setSynthEnvelope(attack: number, decay: number, sustain: number, release: number) {
+        board().ensureHardwareVersion(2);
+    }
+
+    const SYNTH_SEQUENCER_ID = 9516;
+    const SYNTH_TRACKS = 4;
+    let synthTracks: { timer: any, frequency: number }[] = [];
+
+    export function playTrack(track: number, notes: RefBuffer, loop: boolean) {
+        board().ensureHardwareVersion(2);
+        if (!notes || track < 0 || track >= SYNTH_TRACKS)
+            return;
+        stopTrack(track);
+        const data = notes.data;
+        if (data.length < 6)
+            return;
+        const state = { timer: undefined as any, frequency: 0 };
+        synthTracks[track] = state;
+        let next = 0;
+        const rt = runtime;
+        const step = () => {
+            // the simulator was restarted
+            if (runtime !== rt)
+                return;
+            if (state.frequency)
+                synthNoteOff(state.frequency);
+            state.frequency = 0;
+            if (next + 6 > data.length) {
+                if (!loop) {
+                    synthTracks[track] = undefined;
+                    board().bus.queue(SYNTH_SEQUENCER_ID, track + 1);
+                    return;
+                }
+                next = 0;
+            }
+            const frequency = data[next] | (data[next + 1] << 8);
+            const ms = data[next + 2] | (data[next + 3] << 8);
+            const volume = data[next + 4];
+            next += 6;
+            if (frequency && volume) {
+                synthNoteOn(frequency, volume, data[next - 1]);
+                state.frequency = frequency;
+            }
+            state.timer = setTimeout(step, Math.max(1, ms));
+        };
+        step();
+    }
+
+    export function stopTrack(track: number) {
+        for (let k = 0; k < SYNTH_TRACKS; ++k) {
+            const state = synthTracks[k];
+            if (state && (track < 0 || track == k)) {
+                clearTimeout(state.timer);
+                if (state.frequency)
+                    synthNoteOff(state.frequency);
+                synthTracks[k] = undefined;
+            }
+        }
+    }
+
+    export function isTrackPlaying(track: number): boolean {
+        for (let k = 0; k < SYNTH_TRACKS; ++k)
+            if (synthTracks[k] && (track < 0 || track == k))
+                return true;
+        return false;
+    }
+
+    export function onTrackDone(track: number, handler: RefAction) {
+        pxtcore.registerWithDal(SYNTH_SEQUENCER_ID, track + 1, handler);
+    }
 }
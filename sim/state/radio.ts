@@ -0,0 +1,130 @@
+namespace pxsim {
+    // radio protocol number of the frames of the protocols layered on the radio, as in radiobatch.cpp
+    const RADIO_PROTOCOL_LAYERED = 3;
+    const RADIO_FRAME_TYPE_PROTOCOL = 32;
+    const RADIO_PROTOCOL_QUEUE_SIZE = 8;
+    const RADIO_PROTOCOL_EVT_ID = 9518;
+
+    /**
+     * Frames of the protocols layered on the radio, such as the reliable transport, and their
+     * traffic counters. The frames travel as radio packets with their own payload type. The
+     * board creates this state along with the radio, and from then on it takes them from the
+     * datagram as they arrive, so radio.ts never reads them. The simulated radio has no frame
+     * size to fill, so frames always go out on their own.
+     */
+    export class RadioProtocolState {
+        counters = [0, 0, 0, 0, 0, 0];
+        windowStart = 0;
+        windowFrames = 0;
+        windowBytes = 0;
+        framesPerSecond = 0;
+        bytesPerSecond = 0;
+        packets: any[] = [];
+        handled: boolean[] = [];
+
+        constructor(private readonly radioState: RadioState) {
+            const datagram: any = radioState.datagram;
+            const queue = datagram.queue;
+            datagram.queue = (packet: any) => {
+                if (packet && packet.payload && packet.payload.type == RADIO_PROTOCOL_LAYERED)
+                    this.receive(packet);
+                else
+                    queue.call(datagram, packet);
+            };
+        }
+
+        send(data: Uint8Array) {
+            if (!data.length || data[0] < RADIO_FRAME_TYPE_PROTOCOL)
+                return;
+            this.radioState.datagram.send({
+                type: RADIO_PROTOCOL_LAYERED,
+                groupId: this.radioState.groupId,
+                bufferData: data
+            });
+            this.counters[0]++;
+            this.counters[1] += data.length;
+            this.counters[4]++;
+        }
+
+        receive(packet: any) {
+            const data: Uint8Array = packet.payload.bufferData;
+            if (!data || !data.length)
+                return;
+            this.counters[2]++;
+            this.counters[3] += data.length;
+            if (!this.handled[data[0]])
+                return;
+            this.counters[5]++;
+            if (this.packets.length < RADIO_PROTOCOL_QUEUE_SIZE) {
+                this.packets.push(packet);
+                board().bus.queue(RADIO_PROTOCOL_EVT_ID, data[0]);
+            }
+        }
+
+        // frames are only kept for the types that have a handler
+        handle(type: number, handler: RefAction) {
+            if (type < RADIO_FRAME_TYPE_PROTOCOL || type > 255)
+                return;
+            this.handled[type] = true;
+            pxtcore.registerWithDal(RADIO_PROTOCOL_EVT_ID, type, handler);
+        }
+
+        read(type: number): RefBuffer {
+            for (let i = 0; i < this.packets.length; ++i) {
+                const packet = this.packets[i];
+                const data: Uint8Array = packet.payload.bufferData;
+                if (data[0] != type)
+                    continue;
+                this.packets.splice(i, 1);
+                // packet bytes then the RSSI, as for readRawPacket
+                const buf = BufferMethods.createBuffer(36);
+                buf.data.set(data.subarray(0, 32));
+                const rssi = (packet.rssi || 0) | 0;
+                for (let k = 0; k < 4; ++k)
+                    buf.data[32 + k] = (rssi >> (8 * k)) & 0xff;
+                return buf;
+            }
+            return undefined;
+        }
+
+        update() {
+            const now = runtime.runningTime();
+            const elapsed = now - this.windowStart;
+            if (elapsed < 1000)
+                return;
+            const frames = this.counters[0] + this.counters[2];
+            const bytes = this.counters[1] + this.counters[3];
+            this.framesPerSecond = Math.floor((frames - this.windowFrames) * 1000 / elapsed);
+            this.bytesPerSecond = Math.floor((bytes - this.windowBytes) * 1000 / elapsed);
+            this.windowStart = now;
+            this.windowFrames = frames;
+            this.windowBytes = bytes;
+        }
+    }
+}
+
+namespace pxsim.radio {
+    export function setBatching(latency: number, compressHeaders: boolean) {
+    }
+
+    export function statistic(statistic: number): number {
+        const s = board().radioProtocolState;
+        s.update();
+        if (statistic == 6) return s.framesPerSecond;
+        if (statistic == 7) return s.bytesPerSecond;
+        return s.counters[statistic] || 0;
+    }
+
+    export function sendProtocolPacket(frame: RefBuffer) {
+        if (frame)
+            board().radioProtocolState.send(frame.data.slice(0, 32));
+    }
+
+    export function readProtocolPacket(type: number): RefBuffer {
+        return board().radioProtocolState.read(type);
+    }
+
+    export function onProtocolPacket(type: number, handler: RefAction) {
+        board().radioProtocolState.handle(type, handler);
+    }
+}
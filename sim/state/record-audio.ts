@@ -231,4 +231,8 @@ namespace pxsim.record {
     export function setBothSamples(sampleRate: number): void {
 
     }
+
+    // the browser recorder has no memory limit to work around
+    export function setFlashStorage(flash: boolean): void {
+    }
 }
\ No newline at end of file